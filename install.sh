@@ -1,3 +1,3 @@
 #!/bin/sh
 mkdir /usr/local/include/rvector
-cp src/rvector.h src/allocator.h /usr/local/include/rvector
\ No newline at end of file
+cp src/rvector.h src/small_rvector.h src/persistent_rvector.h src/concurrent_rvector.h src/snapshot_rvector.h src/traced_rvector.h src/allocator.h /usr/local/include/rvector
\ No newline at end of file
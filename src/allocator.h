@@ -2,16 +2,224 @@
 #include <string.h>
 #include <algorithm>
 #include <memory>
+#include <array>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
 #include <linux/mman.h>
+#include <new>
+#include <unistd.h>
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <system_error>
+#include <limits>
+#include <memory_resource>
+#include <unordered_map>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
 
 #define LIKELY(x)       __builtin_expect((x),1)
 #define UNLIKELY(x)     __builtin_expect((x),0)
 
 namespace mm
 {
-	int mremap_skips = 0;
-	int grows = 0;
+// telemetry
+	// Allocation counters per element type, compiled in with
+	// RVECTOR_TELEMETRY. Every thread bumps its own relaxed counters;
+	// snapshot<T>() sums the live threads and the ones that already exited.
+	namespace telemetry
+	{
+#ifdef RVECTOR_TELEMETRY
+		constexpr bool enabled = true;
+#else
+		constexpr bool enabled = false;
+#endif
+		enum counter
+		{
+			inplace_remaps,  // block resized by mremap/mprotect where it was
+			page_moves,      // mremap moved the pages to a new address
+			fallback_copies, // new block allocated and elements moved over
+			bytes_copied,    // bytes moved by fallback copies
+			map_transitions, // malloc block replaced by a mapping
+			cache_hits,      // mapping reused from the thread's cache
+			cow_clones,      // copy that shares pages with its source
+			counters
+		};
+
+		enum syscall { sys_mmap, sys_mremap, sys_munmap, syscalls };
+
+		// latency[s][b] counts calls of s that took [2^(b-1), 2^b) ns.
+		constexpr size_t buckets = 32;
+
+		struct stats
+		{
+			uint64_t count[counters] = {};
+			uint64_t latency[syscalls][buckets] = {};
+
+			stats& operator+=(const stats& other)
+			{
+				for(size_t i = 0; i < counters; ++i)
+					count[i] += other.count[i];
+				for(size_t s = 0; s < syscalls; ++s)
+					for(size_t b = 0; b < buckets; ++b)
+						latency[s][b] += other.latency[s][b];
+				return *this;
+			}
+		};
+
+		template<typename T>
+		class registry
+		{
+			struct slot
+			{
+				std::atomic<uint64_t> count[counters] = {};
+				std::atomic<uint64_t> latency[syscalls][buckets] = {};
+
+				slot()
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					slots.push_back(this);
+				}
+
+				~slot()
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					retired += read(*this);
+					slots.erase(std::find(slots.begin(), slots.end(), this));
+				}
+			};
+
+			static stats read(const slot& s)
+			{
+				stats result;
+				for(size_t i = 0; i < counters; ++i)
+					result.count[i] = s.count[i].load(std::memory_order_relaxed);
+				for(size_t c = 0; c < syscalls; ++c)
+					for(size_t b = 0; b < buckets; ++b)
+						result.latency[c][b] = 
+							s.latency[c][b].load(std::memory_order_relaxed);
+				return result;
+			}
+
+			static void bump(std::atomic<uint64_t>& value, uint64_t n)
+			{
+				value.store(value.load(std::memory_order_relaxed) + n, 
+							std::memory_order_relaxed);
+			}
+
+			static slot& local()
+			{
+				thread_local slot s;
+				return s;
+			}
+
+			static inline std::mutex lock;
+			static inline std::vector<slot*> slots;
+			static inline stats retired;
+		public:
+			static void add(counter c, uint64_t n)
+			{
+				bump(local().count[c], n);
+			}
+
+			static void add_latency(syscall c, uint64_t ns)
+			{
+				size_t b = ns ? std::min<size_t>(64 - __builtin_clzll(ns), 
+												buckets - 1) : 0;
+				bump(local().latency[c][b], 1);
+			}
+
+			static stats snapshot()
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stats result = retired;
+				for(auto s : slots)
+					result += read(*s);
+				return result;
+			}
+
+			static void reset()
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				retired = stats();
+				for(auto s : slots)
+				{
+					for(auto& c : s->count)
+						c.store(0, std::memory_order_relaxed);
+					for(auto& l : s->latency)
+						for(auto& b : l)
+							b.store(0, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		template<typename T>
+		stats snapshot()
+		{
+			return registry<T>::snapshot();
+		}
+
+		template<typename T>
+		void reset()
+		{
+			registry<T>::reset();
+		}
+
+		template<typename T>
+		void add(counter c, uint64_t n = 1)
+		{
+			if constexpr(enabled)
+				registry<T>::add(c, n);
+		}
+
+		template<typename T, typename F>
+		auto timed(syscall c, F call)
+		{
+			if constexpr(!enabled)
+				return call();
+			else
+			{
+				auto begin = std::chrono::steady_clock::now();
+				auto result = call();
+				registry<T>::add_latency(c, 
+					std::chrono::duration_cast<std::chrono::nanoseconds>(
+						std::chrono::steady_clock::now() - begin).count());
+				return result;
+			}
+		}
+
+		inline std::ostream& operator<<(std::ostream& out, const stats& s)
+		{
+			const char* names[] = {"inplace_remaps", "page_moves", 
+				"fallback_copies", "bytes_copied", "map_transitions", 
+				"cache_hits", "cow_clones"};
+			const char* calls[] = {"mmap", "mremap", "munmap"};
+			for(size_t i = 0; i < counters; ++i)
+				out << names[i] << ": " << s.count[i] << std::endl;
+			for(size_t c = 0; c < syscalls; ++c)
+			{
+				out << calls[c] << " ns:";
+				for(size_t b = 0; b < buckets; ++b)
+					if(s.latency[c][b])
+						out << " <" << (1ull << b) << ":" << s.latency[c][b];
+				out << std::endl;
+			}
+			return out;
+		}
+	} // namespace telemetry
+
 	// Policies
 	template<typename T>
 	using Trivial = std::enable_if_t<std::is_trivial<T>::value>;
@@ -36,27 +244,969 @@ namespace mm
 	template<typename T>
 	using NT_Move_a = std::enable_if_t<!std::is_trivially_move_assignable<T>::value>;
 
+	// A type is trivially relocatable when moving an object and destroying
+	// the source is equivalent to copying its bytes, i.e. it holds no
+	// pointers into itself. Such elements are moved with memcpy, realloc and
+	// MREMAP_MAYMOVE. Specialise for your own types to opt in.
+	template<typename T>
+	struct is_trivially_relocatable
+	 : std::is_trivially_move_constructible<T> {};
+
+	template<typename T>
+	struct is_trivially_relocatable<std::unique_ptr<T>> : std::true_type {};
+	template<typename T>
+	struct is_trivially_relocatable<std::shared_ptr<T>> : std::true_type {};
+	template<typename T>
+	struct is_trivially_relocatable<std::weak_ptr<T>> : std::true_type {};
+	template<typename T>
+	struct is_trivially_relocatable<std::vector<T>> : std::true_type {};
+#ifdef _LIBCPP_VERSION
+	// libstdc++ strings point into their own small buffer, libc++ ones do not.
+	template<typename C, typename Tr>
+	struct is_trivially_relocatable<std::basic_string<C, Tr>> : std::true_type {};
+#endif
+	template<typename T1, typename T2>
+	struct is_trivially_relocatable<std::pair<T1, T2>>
+	 : std::conjunction<is_trivially_relocatable<T1>, 
+	 					is_trivially_relocatable<T2>> {};
+	template<typename T, size_t N>
+	struct is_trivially_relocatable<std::array<T, N>> 
+	 : is_trivially_relocatable<T> {};
+
+	// A type is zero initializable when T() is the all-zero bit pattern.
+	// Value-initialized elements on fresh mapped pages, which the kernel
+	// zeroes, are then left to the first touch. Specialise for your own
+	// types to opt in.
+	template<typename T>
+	struct is_zero_initializable
+	 : std::bool_constant<std::is_arithmetic<T>::value or 
+	 					std::is_enum<T>::value or std::is_pointer<T>::value> {};
+
+	template<typename T1, typename T2>
+	struct is_zero_initializable<std::pair<T1, T2>>
+	 : std::conjunction<is_zero_initializable<T1>, 
+	 					is_zero_initializable<T2>> {};
+	template<typename T, size_t N>
+	struct is_zero_initializable<std::array<T, N>> 
+	 : is_zero_initializable<T> {};
+
+	template<typename T, typename R = void>
+	using T_Reloc = std::enable_if_t<is_trivially_relocatable<T>::value, R>;
+	template<typename T, typename R = void>
+	using NT_Reloc = std::enable_if_t<!is_trivially_relocatable<T>::value, R>;
+
 	using size_type = size_t;
-	template <typename T>
-	constexpr size_t map_threshold = 4096 / sizeof(T);
+
+	constexpr size_type huge_page_size = 2 << 20;
+
+	constexpr size_type huge_round(size_type bytes)
+	{
+		return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+	}
+
+	// How the pages past the length of a mapped vector are faulted in.
+	enum class prefault
+	{
+		none,		// on the first write to each page
+		populate,	// all at once when the capacity grows
+		chunked		// chunk by chunk until a time budget runs out
+	};
+
+	// NUMA placement of mapped storage; the values are the kernel's MPOL_*.
+	enum class numa
+	{
+		none,		// the process policy, usually the faulting thread's node
+		preferred,	// the first of the nodes while it has free memory
+		bind,		// only the nodes
+		interleave	// page by page round robin over the nodes
+	};
+
+	// Runs f(i) for every i in [0, n) on the calling thread; the default
+	// executor of policies. See thread_executor.
+	struct inline_executor
+	{
+		template<typename F>
+		void bulk(size_type n, F f)
+		{
+			for(size_type i = 0; i < n; ++i)
+				f(i);
+		}
+	};
+
+	// Allocation policy of an rvector. A policy P derives from basic_policy<P>
+	// and hides the members it wants to change; the defaults read P's own
+	// members, so overriding page_size alone also moves map_threshold.
+	template<typename P>
+	struct basic_policy
+	{
+		// Page size used for the malloc/mmap split and mapped capacities.
+		static size_type page_size() noexcept
+		{
+			static const size_type size = sysconf(_SC_PAGESIZE);
+			return size;
+		}
+
+		// Capacities above map_threshold live in their own mapping.
+		template<typename T>
+		static size_type map_threshold() noexcept
+		{
+			return std::max<size_type>(P::page_size() / sizeof(T), 1);
+		}
+
+		// Capacity requested when a full vector needs one more element.
+		template<typename T>
+		static size_type grow(size_type capacity) noexcept
+		{
+			return capacity*2 + 1;
+		}
+
+		// Address space reserved up front for mapped storage. Zero disables
+		// the mode; otherwise growth up to reserve_bytes only commits more
+		// pages of the range, so the data pointer never changes.
+		static constexpr size_type reserve_bytes = 0;
+
+		// Transparent huge pages for mapped storage. Mappings are aligned to
+		// huge_page_size and advised MADV_HUGEPAGE; capacities of at least
+		// huge_threshold elements are rounded to whole huge pages.
+		static constexpr bool huge_pages = false;
+
+		template<typename T>
+		static size_type huge_threshold() noexcept
+		{
+			return huge_page_size / sizeof(T);
+		}
+
+		// Mapped vectors shrink to length * shrink_ratio / 2 once length
+		// times shrink_ratio drops below capacity, so the next shrink waits
+		// until the length halves again. Zero disables auto shrink, other
+		// ratios must be at least 2.
+		static constexpr size_type shrink_ratio = 0;
+
+		// Whole pages past the end of a mapped vector are handed back with
+		// madvise(release_advice) once pop_back, erase, resize or clear free
+		// at least release_bytes. Zero keeps them mapped.
+		static constexpr size_type release_bytes = 0;
+		static constexpr int release_advice = MADV_FREE;
+
+		// Growth of a mapped vector prefaults the pages between its length
+		// and the new capacity, so appends do not take the faults later.
+		// Chunked mode stops once prefault_budget has elapsed.
+		static constexpr prefault prefault_mode = prefault::none;
+		static constexpr std::chrono::nanoseconds prefault_budget = 
+			std::chrono::milliseconds(1);
+
+		// Each thread keeps released mappings of up to cache_bytes in total
+		// and hands them to later allocations of up to the same size,
+		// without mmap or munmap. Huge page and reserved mappings are never cached.
+		// Zero disables the cache.
+		static constexpr size_type cache_bytes = 0;
+
+		// Storage comes from a std::pmr::memory_resource instead of malloc
+		// and mmap; see pmr_policy.
+		static constexpr bool uses_resource = false;
+
+		// Mapped storage lives in a memfd, and copies of trivially copyable
+		// elements map the same file MAP_PRIVATE, so either side duplicates
+		// only the pages it writes. Incompatible with huge_pages and
+		// reserve_bytes.
+		static constexpr bool copy_on_write = false;
+
+		// Mapped storage is placed with mbind in numa_mode over the nodes in
+		// the numa_nodes() bit mask, or over every allowed node for an empty
+		// mask. mremap carries the placement along as a block grows.
+		// Kernels without NUMA support ignore it.
+		static constexpr numa numa_mode = numa::none;
+
+		static unsigned long numa_nodes() noexcept
+		{
+			return 0;
+		}
+
+		// Fills given an executor split at least parallel_bytes into chunks
+		// that run in parallel, so each thread first touches its own pages.
+		// Smaller ones run on the calling thread.
+		static constexpr size_type parallel_bytes = 64 << 20;
+
+		// Fills, copies and relocations of trivially copyable elements of at
+		// least stream_bytes use non-temporal stores, which bypass the caches,
+		// so a block far larger than the LLC does not evict the working set.
+		// Zero disables them.
+		static constexpr size_type stream_bytes = 0;
+
+		// Inserts and erases in long mapped vectors move whole pages with
+		// mremap, and every move splits the block into more mappings. Once
+		// the process holds shift_max_maps mappings they memmove instead.
+		// Zero means half of vm.max_map_count.
+		static constexpr size_type shift_max_maps = 0;
+
+		// Executor of copy construction, copy assignment and assign from
+		// random access ranges once they reach parallel_bytes.
+		static inline_executor& executor() noexcept
+		{
+			static inline_executor ex;
+			return ex;
+		}
+	};
+
+	struct default_policy : basic_policy<default_policy>
+	{
+	};
+
+	// Grows by 1.5x while in malloc, doubles mapped blocks up to linear_step
+	// and then grows them linearly, as mremap makes each step cheap.
+	struct compact_policy : basic_policy<compact_policy>
+	{
+		static constexpr size_type linear_step = 64 << 20;
+
+		template<typename T>
+		static size_type grow(size_type capacity) noexcept
+		{
+			if(capacity < map_threshold<T>())
+				return capacity + capacity/2 + 1;
+			size_type step = std::max<size_type>(linear_step / sizeof(T), 1);
+			return capacity < step ? capacity*2 + 1 : capacity + step;
+		}
+	};
+
+	// Takes all storage from a memory resource: the one passed to the
+	// rvector constructor, or default_resource() for vectors built without
+	// one. The resource is stored in a header in front of the elements, so
+	// the vector keeps its layout. Copies use the default resource, like
+	// std::pmr containers do.
+	struct pmr_policy : basic_policy<pmr_policy>
+	{
+		static constexpr bool uses_resource = true;
+
+		template<typename T>
+		static size_type map_threshold() noexcept
+		{
+			return std::numeric_limits<size_type>::max();
+		}
+
+		static std::pmr::memory_resource* default_resource() noexcept
+		{
+			return std::pmr::get_default_resource();
+		}
+	};
+
+	template<typename P>
+	size_type page_round(size_type bytes)
+	{
+		return (bytes + P::page_size() - 1) & ~(P::page_size() - 1);
+	}
+
+	template<typename P>
+	size_type reserved_size()
+	{
+		return page_round<P>(P::reserve_bytes);
+	}
+
+	template<typename T, typename P>
+	bool is_mapped(size_type n)
+	{
+		return n > P::template map_threshold<T>();
+	}
+
+	template<typename T, typename P>
+	size_type mapped_size(size_type n)
+	{
+		if constexpr(P::reserve_bytes > 0)
+			return std::max(reserved_size<P>(), n*sizeof(T));
+		return n*sizeof(T);
+	}
+
+// numa
+	constexpr unsigned long numa_max_nodes = 8 * sizeof(unsigned long);
+
+	// Nodes the process may allocate on, node 0 alone when unknown.
+	inline unsigned long numa_allowed() noexcept
+	{
+		static const unsigned long nodes = [] {
+			const int mems_allowed = 4;
+			unsigned long mask = 0;
+			if(syscall(SYS_get_mempolicy, nullptr, &mask, numa_max_nodes, 
+						nullptr, mems_allowed) or !mask)
+				mask = 1;
+			return mask;
+		}();
+		return nodes;
+	}
+
+	// Applies the placement of P to bytes of a new mapping. A failed mbind
+	// leaves the default placement.
+	template<typename P>
+	void place(void* data, size_type bytes) noexcept
+	{
+		if constexpr(P::numa_mode != numa::none)
+		{
+			unsigned long nodes = P::numa_nodes() ? P::numa_nodes() 
+												: numa_allowed();
+			syscall(SYS_mbind, data, page_round<P>(bytes), 
+					(int) P::numa_mode, &nodes, numa_max_nodes + 1, 0);
+		}
+	}
+
+	// Placement in effect for the page holding addr.
+	inline numa placement(const void* addr) noexcept
+	{
+		const int by_addr = 2;
+		int mode = 0;
+		if(syscall(SYS_get_mempolicy, &mode, nullptr, 0, addr, by_addr))
+			return numa::none;
+		mode &= 0xff;
+		return mode <= (int) numa::interleave ? (numa) mode : numa::none;
+	}
+
+	// Node of each page holding bytes [0, bytes) of data, or -ENOENT for a
+	// page not faulted in yet. Without NUMA support every page is on node 0.
+	template<typename P>
+	std::vector<int> page_nodes(const void* data, size_type bytes)
+	{
+		size_type first = (size_type) data & ~(P::page_size() - 1);
+		size_type count = bytes ? 
+			(page_round<P>((size_type) data + bytes) - first) / P::page_size() : 0;
+		std::vector<void*> pages(count);
+		std::vector<int> nodes(count, 0);
+		for(size_type i = 0; i < count; ++i)
+			pages[i] = (void*) (first + i * P::page_size());
+		if(count and syscall(SYS_move_pages, 0, count, pages.data(), nullptr, 
+							nodes.data(), 0))
+			std::fill(nodes.begin(), nodes.end(), 0);
+		return nodes;
+	}
+
+// map
+	template<typename T, typename P>
+	void* map_(size_type bytes, int prot, int flags)
+	{
+		using namespace telemetry;
+		if constexpr(!P::huge_pages)
+		{
+			void* p = timed<T>(sys_mmap, [&] {
+				return mmap(NULL, bytes, prot, flags, -1, 0);
+			});
+			if(UNLIKELY(p == MAP_FAILED))
+				throw std::bad_alloc();
+			place<P>(p, bytes);
+			return p;
+		}
+		else
+		{
+			size_type span = page_round<P>(bytes) + huge_page_size;
+			char* p = (char*) timed<T>(sys_mmap, [&] {
+				return mmap(NULL, span, prot, flags, -1, 0);
+			});
+			if(UNLIKELY(p == MAP_FAILED))
+				throw std::bad_alloc();
+			char* begin = (char*) huge_round((size_type) p);
+			char* end = begin + page_round<P>(bytes);
+			if(begin != p)
+				munmap(p, begin - p);
+			if(end != p + span)
+				munmap(end, p + span - end);
+			madvise(begin, end - begin, MADV_HUGEPAGE);
+			place<P>(begin, end - begin);
+			return begin;
+		}
+	}
+
+// commit
+	template<typename T, typename P>
+	void commit(T* data, size_type capacity, size_type n)
+	{
+		size_type from = page_round<P>(capacity*sizeof(T));
+		size_type to = std::min(page_round<P>(n*sizeof(T)), reserved_size<P>());
+		if(from >= to) return;
+		if(UNLIKELY(mprotect((char*) data + from, to - from, 
+							PROT_READ | PROT_WRITE)))
+			throw std::bad_alloc();
+	}
+
+	// Returns the pages of a reserved range past n to the PROT_NONE state.
+	// The range is dropped and protected rather than mapped over, so it stays
+	// part of the same mapping and a later commit lets mremap extend it.
+	template<typename T, typename P>
+	void decommit(T* data, size_type n, size_type capacity) noexcept
+	{
+		size_type from = page_round<P>(n*sizeof(T));
+		size_type to = std::min(page_round<P>(capacity*sizeof(T)), 
+								reserved_size<P>());
+		if(from >= to) return;
+		madvise((char*) data + from, to - from, MADV_DONTNEED);
+		mprotect((char*) data + from, to - from, PROT_NONE);
+	}
+
+// populate
+	constexpr size_type prefault_chunk = 256 << 10;
+
+	// Faults in the pages holding bytes [from, to) of a mapped block, with
+	// MADV_POPULATE_WRITE or by touching each page on kernels before 5.14.
+	// Returns the bytes populated, short of the range only when a chunked
+	// run exceeds its budget.
+	template<typename P>
+	size_type populate(void* data, size_type from, size_type to, 
+					prefault mode, std::chrono::nanoseconds budget) noexcept
+	{
+		using clock = std::chrono::steady_clock;
+		if(mode == prefault::none) return 0;
+		char* base = (char*) data;
+		from &= ~(P::page_size() - 1);
+		to = page_round<P>(to);
+		size_type step = mode == prefault::chunked ? 
+						page_round<P>(prefault_chunk) : to - from;
+		auto deadline = clock::now() + budget;
+		size_type at = from;
+		while(at < to)
+		{
+			size_type len = std::min(step, to - at);
+			if(madvise(base + at, len, MADV_POPULATE_WRITE) and errno == EINVAL)
+				for(char* p = base + at; p < base + at + len; p += P::page_size())
+					*(volatile char*) p = *(volatile char*) p;
+			at += len;
+			if(mode == prefault::chunked and clock::now() >= deadline)
+				break;
+		}
+		return at - from;
+	}
+
+// cache
+	template<typename P>
+	constexpr bool cached()
+	{
+		return P::cache_bytes > 0 and !P::huge_pages and P::reserve_bytes == 0
+				and !P::copy_on_write;
+	}
+
+	// Released mappings of the calling thread. An allocation takes the
+	// smallest one that fits within split_ratio times its size and leaves
+	// the pages past it cached as a mapping of their own. Mappings belong
+	// to the process, so a vector freed on another thread simply lands in
+	// that thread's cache. The state is trivially destructible and outlives
+	// the closer, so mappings freed by later thread_local destructors are
+	// unmapped directly.
+	template<typename P>
+	class mapping_cache
+	{
+		static constexpr size_type slots = 16;
+		static constexpr size_type split_ratio = 2;
+
+		struct entry
+		{
+			void* p;
+			size_type bytes;
+		};
+
+		struct state
+		{
+			entry entries[slots];
+			size_type count;
+			size_type bytes;
+			bool closed;
+		};
+
+		struct closer
+		{
+			~closer()
+			{
+				trim(0);
+				local().closed = true;
+			}
+		};
+
+		static state& local() noexcept
+		{
+			thread_local state s;
+			return s;
+		}
+
+		static void remove(state& s, size_type i) noexcept
+		{
+			s.bytes -= s.entries[i].bytes;
+			std::copy(s.entries + i + 1, s.entries + s.count, s.entries + i);
+			--s.count;
+		}
+	public:
+		// Returns a cached mapping of bytes, split off a larger one if
+		// needed, or nullptr.
+		static void* take(size_type bytes) noexcept
+		{
+			state& s = local();
+			size_type best = s.count;
+			for(size_type i = s.count; i-- > 0;)
+			{
+				size_type size = s.entries[i].bytes;
+				if(size >= bytes and size / split_ratio <= bytes and 
+					(best == s.count or size < s.entries[best].bytes))
+					best = i;
+			}
+			if(best == s.count)
+				return nullptr;
+			entry e = s.entries[best];
+			remove(s, best);
+			if(e.bytes > bytes)
+			{
+				s.entries[s.count++] = entry{(char*) e.p + bytes, e.bytes - bytes};
+				s.bytes += e.bytes - bytes;
+			}
+			return e.p;
+		}
+
+		// Keeps a mapping for reuse, evicting the oldest ones to stay within
+		// cache_bytes. Returns false if the caller has to unmap it.
+		static bool put(void* p, size_type bytes) noexcept
+		{
+			thread_local closer c;
+			(void) c;
+			state& s = local();
+			if(bytes > P::cache_bytes or s.closed)
+				return false;
+			while(s.count == slots or s.bytes + bytes > P::cache_bytes)
+			{
+				munmap(s.entries[0].p, s.entries[0].bytes);
+				remove(s, 0);
+			}
+			s.entries[s.count++] = entry{p, bytes};
+			s.bytes += bytes;
+			return true;
+		}
+
+		// Unmaps the oldest mappings until at most bytes stay cached.
+		static void trim(size_type bytes = 0) noexcept
+		{
+			state& s = local();
+			while(s.bytes > bytes)
+			{
+				munmap(s.entries[0].p, s.entries[0].bytes);
+				remove(s, 0);
+			}
+		}
+
+		static size_type cached_bytes() noexcept
+		{
+			return local().bytes;
+		}
+	};
+
+// copy on write
+	// State of each memfd backed mapping, keyed by its address. A shared
+	// mapping is the only user of its file and writes go to the file; once
+	// cloned, every mapping of the file is private and the file is frozen.
+	class cow_registry
+	{
+	public:
+		struct entry
+		{
+			int fd;
+			bool shared;
+			size_type file_bytes;
+		};
+
+		static void insert(void* p, entry e)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			table.emplace(p, e);
+		}
+
+		static entry find(void* p)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			return table.at(p);
+		}
+
+		static void update(void* p, entry e)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			table.at(p) = e;
+		}
+
+		static void move(void* from, void* to)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			entry e = table.at(from);
+			table.erase(from);
+			table.emplace(to, e);
+		}
+
+		static entry erase(void* p)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			entry e = table.at(p);
+			table.erase(p);
+			return e;
+		}
+
+	private:
+		static inline std::mutex lock;
+		static inline std::unordered_map<void*, entry> table;
+	};
+
+	template<typename T, typename P>
+	int cow_file(size_type bytes)
+	{
+		int fd = memfd_create("rvector", MFD_CLOEXEC);
+		if(UNLIKELY(fd < 0))
+			throw std::bad_alloc();
+		if(UNLIKELY(ftruncate(fd, bytes)))
+		{
+			close(fd);
+			throw std::bad_alloc();
+		}
+		return fd;
+	}
+
+	template<typename T, typename P>
+	void* cow_map(size_type bytes)
+	{
+		bytes = page_round<P>(bytes);
+		int fd = cow_file<T, P>(bytes);
+		void* p = telemetry::timed<T>(telemetry::sys_mmap, [&] {
+			return mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		});
+		if(UNLIKELY(p == MAP_FAILED))
+		{
+			close(fd);
+			throw std::bad_alloc();
+		}
+		place<P>(p, bytes);
+		cow_registry::insert(p, {fd, true, bytes});
+		return p;
+	}
+
+	template<typename T, typename P>
+	void cow_unmap(void* p, size_type bytes) noexcept
+	{
+		telemetry::timed<T>(telemetry::sys_munmap, [&] {
+			return munmap(p, bytes);
+		});
+		close(cow_registry::erase(p).fd);
+	}
+
+	// Whether a private mapping holds pages written since it was cloned,
+	// which the file does not have. /proc/self/pagemap marks pages still
+	// backed by the file with bit 61; anonymous copies lack it, either
+	// present (bit 63) or swapped out (bit 62). Answers true when pagemap
+	// cannot be read.
+	template<typename P>
+	bool cow_dirty(void* p, size_type bytes) noexcept
+	{
+		int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+		if(fd < 0) return true;
+		constexpr size_type batch = 512;
+		uint64_t pages[batch];
+		size_type first = (size_type) p / P::page_size();
+		size_type count = page_round<P>(bytes) / P::page_size();
+		bool dirty = false;
+		for(size_type i = 0; i < count and !dirty; i += batch)
+		{
+			size_type n = std::min(batch, count - i);
+			ssize_t r = pread(fd, pages, n * sizeof(uint64_t), 
+							(first + i) * sizeof(uint64_t));
+			if(r != (ssize_t) (n * sizeof(uint64_t)))
+				dirty = true;
+			for(size_type j = 0; j < n and !dirty; ++j)
+				dirty = (pages[j] >> 62 & 3) and !(pages[j] >> 61 & 1);
+		}
+		close(fd);
+		return dirty;
+	}
+
+	// Gives a private mapping its own shared file holding the current
+	// contents, copying the first used bytes.
+	template<typename T, typename P>
+	void cow_materialize(void* p, size_type bytes, size_type used)
+	{
+		cow_registry::entry e = cow_registry::find(p);
+		bytes = page_round<P>(bytes);
+		int fd = cow_file<T, P>(bytes);
+		void* tmp = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(UNLIKELY(tmp == MAP_FAILED))
+		{
+			close(fd);
+			throw std::bad_alloc();
+		}
+		memcpy(tmp, p, std::min(used, bytes));
+		if(UNLIKELY(mremap(tmp, bytes, bytes, MREMAP_MAYMOVE | MREMAP_FIXED, p) 
+					== MAP_FAILED))
+		{
+			munmap(tmp, bytes);
+			close(fd);
+			throw std::bad_alloc();
+		}
+		close(e.fd);
+		cow_registry::update(p, {fd, true, bytes});
+		telemetry::add<T>(telemetry::fallback_copies);
+		telemetry::add<T>(telemetry::bytes_copied, used);
+	}
+
+	// Resizes a memfd mapping. A private one is materialized first, as its
+	// file is frozen. Returns MAP_FAILED when mremap with flags fails.
+	template<typename T, typename P>
+	void* cow_remap(void* p, size_type old_bytes, size_type new_bytes, 
+					size_type used, int flags)
+	{
+		cow_registry::entry e = cow_registry::find(p);
+		if(!e.shared)
+		{
+			cow_materialize<T, P>(p, old_bytes, used);
+			e = cow_registry::find(p);
+		}
+		new_bytes = page_round<P>(new_bytes);
+		if(new_bytes > e.file_bytes)
+		{
+			if(UNLIKELY(ftruncate(e.fd, new_bytes)))
+				throw std::bad_alloc();
+			e.file_bytes = new_bytes;
+			cow_registry::update(p, e);
+		}
+		void* q = telemetry::timed<T>(telemetry::sys_mremap, [&] {
+			return mremap(p, old_bytes, new_bytes, flags);
+		});
+		if(q != MAP_FAILED and q != p)
+			cow_registry::move(p, q);
+		return q;
+	}
+
+	// Maps the pages of a memfd mapping a second time, so that the copy
+	// costs page table entries instead of bytes. The source turns private
+	// too; if it wrote pages since its last clone, it gets a new file first.
+	template<typename T, typename P>
+	void* cow_clone(void* p, size_type bytes, size_type used)
+	{
+		bytes = page_round<P>(bytes);
+		cow_registry::entry e = cow_registry::find(p);
+		if(!e.shared and cow_dirty<P>(p, used))
+		{
+			cow_materialize<T, P>(p, bytes, used);
+			e = cow_registry::find(p);
+		}
+		if(e.shared)
+		{
+			if(UNLIKELY(mmap(p, bytes, PROT_READ | PROT_WRITE, 
+							MAP_PRIVATE | MAP_FIXED, e.fd, 0) == MAP_FAILED))
+				throw std::bad_alloc();
+			e.shared = false;
+			cow_registry::update(p, e);
+		}
+		int fd = dup(e.fd);
+		if(UNLIKELY(fd < 0))
+			throw std::bad_alloc();
+		void* q = telemetry::timed<T>(telemetry::sys_mmap, [&] {
+			return mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		});
+		if(UNLIKELY(q == MAP_FAILED))
+		{
+			close(fd);
+			throw std::bad_alloc();
+		}
+		cow_registry::insert(q, {fd, false, e.file_bytes});
+		telemetry::add<T>(telemetry::cow_clones);
+		return q;
+	}
+
+// resource
+	// A memory resource that may resize a block where it lies.
+	class extendable_resource : public std::pmr::memory_resource
+	{
+	public:
+		bool extend(void* p, size_type old_bytes, size_type new_bytes) noexcept
+		{
+			return do_extend(p, old_bytes, new_bytes);
+		}
+
+	private:
+		virtual bool do_extend(void* p, size_type old_bytes, 
+								size_type new_bytes) noexcept = 0;
+	};
+
+	// Monotonic arena over a single mapping of up to bytes. The newest
+	// block can grow or shrink in place and freeing it hands its space back;
+	// other blocks stay until release() unmaps the whole arena at once.
+	// Allocations that do not fit throw std::bad_alloc.
+	template<typename P = default_policy>
+	class arena_resource : public extendable_resource
+	{
+	public:
+		explicit arena_resource(size_type bytes) noexcept
+		: size_(page_round<P>(bytes))
+		{}
+
+		arena_resource(const arena_resource&) = delete;
+		arena_resource& operator=(const arena_resource&) = delete;
+
+		~arena_resource()
+		{
+			release();
+		}
+
+		void release() noexcept
+		{
+			if(base_)
+				telemetry::timed<char>(telemetry::sys_munmap, [&] {
+					return munmap(base_, size_);
+				});
+			base_ = nullptr;
+			top_ = last_ = 0;
+		}
+
+		size_type used() const noexcept
+		{
+			return top_;
+		}
+
+	private:
+		void* do_allocate(size_type bytes, size_type alignment) override
+		{
+			if(!base_)
+				base_ = (char*) map_<char, P>(size_, PROT_READ | PROT_WRITE,
+							MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE);
+			size_type offset = (top_ + alignment - 1) & ~(alignment - 1);
+			if(UNLIKELY(offset > size_ or bytes > size_ - offset))
+				throw std::bad_alloc();
+			last_ = offset;
+			top_ = offset + bytes;
+			return base_ + offset;
+		}
+
+		void do_deallocate(void* p, size_type bytes, size_type) override
+		{
+			if((char*) p == base_ + last_ and last_ + bytes == top_)
+				top_ = last_;
+		}
+
+		bool do_extend(void* p, size_type old_bytes, 
+						size_type new_bytes) noexcept override
+		{
+			size_type offset = (char*) p - base_;
+			if(!base_ or offset != last_ or offset + old_bytes != top_ or 
+				new_bytes > size_ - offset)
+				return false;
+			top_ = offset + new_bytes;
+			return true;
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) 
+			const noexcept override
+		{
+			return this == &other;
+		}
+
+		char* base_ = nullptr;
+		size_type size_;
+		size_type top_ = 0;
+		size_type last_ = 0;
+	};
+
+	constexpr size_type resource_header = alignof(std::max_align_t);
+
+	template<typename T>
+	std::pmr::memory_resource*& resource_of(T* data) noexcept
+	{
+		return *(std::pmr::memory_resource**) ((char*) data - resource_header);
+	}
 
 	template<typename T>
+	T* resource_allocate(std::pmr::memory_resource* resource, size_type n)
+	{
+		static_assert(alignof(T) <= resource_header, 
+					"over-aligned types need their own resource header");
+		char* p = (char*) resource->allocate(resource_header + n*sizeof(T), 
+											resource_header);
+		new (p) std::pmr::memory_resource*(resource);
+		return (T*) (p + resource_header);
+	}
+
+	template<typename T>
+	void resource_deallocate(T* data, size_type n)
+	{
+		if(!data) return;
+		resource_of(data)->deallocate((char*) data - resource_header, 
+						resource_header + n*sizeof(T), resource_header);
+	}
+
+	// Grows the block in place when the resource allows it, otherwise
+	// moves the elements to a new block of the same resource.
+	template<typename T>
+	T* resource_realloc(T* data, size_type length, size_type capacity, 
+						size_type n)
+	{
+		using namespace telemetry;
+		std::pmr::memory_resource* resource = resource_of(data);
+		if(auto r = dynamic_cast<extendable_resource*>(resource))
+			if(r->extend((char*) data - resource_header, 
+						resource_header + capacity*sizeof(T),
+						resource_header + n*sizeof(T)))
+			{
+				add<T>(inplace_remaps);
+				return data;
+			}
+		T* new_data = resource_allocate<T>(resource, n);
+		if constexpr(is_trivially_relocatable<T>::value)
+			memcpy((void*) new_data, (void*) data, length * sizeof(T));
+		else
+		{
+			std::uninitialized_move_n(data, length, new_data);
+			std::destroy_n(data, length);
+		}
+		resource_deallocate(data, capacity);
+		add<T>(fallback_copies);
+		add<T>(bytes_copied, length * sizeof(T));
+		return new_data;
+	}
+
+	template<typename T, typename P = default_policy>
 	T* allocate(size_type n)
 	{
-		if(n > map_threshold<T>)
-	    	return (T*) mmap(NULL, n*sizeof(T), 
+		static_assert(!P::copy_on_write or 
+					(!P::huge_pages and P::reserve_bytes == 0),
+					"copy_on_write mappings cannot be huge or reserved");
+		static_assert(P::shrink_ratio == 0 or P::shrink_ratio >= 2,
+					"a shrink_ratio below 2 would shrink below the length");
+		if constexpr(P::uses_resource)
+			return resource_allocate<T>(P::default_resource(), n);
+		if(is_mapped<T, P>(n))
+		{
+			if constexpr(P::copy_on_write)
+				return (T*) cow_map<T, P>(n*sizeof(T));
+			if constexpr(P::reserve_bytes > 0)
+			{
+				if(n*sizeof(T) <= reserved_size<P>())
+				{
+					void* p = map_<T, P>(mapped_size<T, P>(n), PROT_NONE,
+									MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE);
+					commit<T, P>((T*) p, 0, n);
+					return (T*) p;
+				}
+			}
+			if constexpr(cached<P>())
+				if(void* p = mapping_cache<P>::take(page_round<P>(n*sizeof(T))))
+				{
+					telemetry::add<T>(telemetry::cache_hits);
+					return (T*) p;
+				}
+	    	return (T*) map_<T, P>(n*sizeof(T), 
 	                PROT_READ | PROT_WRITE,
-	                MAP_PRIVATE | MAP_ANONYMOUS,
-	                -1, 0);
+	                MAP_PRIVATE | MAP_ANONYMOUS);
+		}
 	    else
         	return (T*) malloc(n*sizeof(T));
 	}
 
-	template<typename T>
+	template<typename T, typename P = default_policy>
 	void deallocate(T* p, size_type n)
 	{
-		if(n > map_threshold<T>)
-	    	munmap(p, n*sizeof(T));
+		if constexpr(P::uses_resource)
+			return resource_deallocate(p, n);
+		if(is_mapped<T, P>(n))
+		{
+			if constexpr(P::copy_on_write)
+				return cow_unmap<T, P>(p, mapped_size<T, P>(n));
+			if constexpr(cached<P>())
+				if(mapping_cache<P>::put(p, page_round<P>(n*sizeof(T))))
+					return;
+	    	telemetry::timed<T>(telemetry::sys_munmap, [&] {
+	    		return munmap(p, mapped_size<T, P>(n));
+	    	});
+		}
 	    else
 	        free(p);
 	}
@@ -75,122 +1225,909 @@ namespace mm
 	{
 	}
 
-// fill
+// stream
+#if defined(__x86_64__)
+	// Stores to aligned vectors of dst, loading src unaligned. Going
+	// backwards when dst is above src, each load stays below the stores
+	// done so far, so the ranges may overlap as for memmove.
+	template<size_type width, typename Step>
+	inline __attribute__((always_inline)) 
+	void stream_move_(char* dst, const char* src, size_type bytes, 
+					Step step) noexcept
+	{
+		if(dst <= src)
+		{
+			size_type head = std::min((0 - (size_type) dst) & (width - 1), bytes);
+			memmove(dst, src, head);
+			dst += head, src += head, bytes -= head;
+			for(; bytes >= width; bytes -= width, dst += width, src += width)
+				step(dst, src);
+			memmove(dst, src, bytes);
+		}
+		else
+		{
+			size_type tail = std::min((size_type) (dst + bytes) & (width - 1), 
+									bytes);
+			memmove(dst + bytes - tail, src + bytes - tail, tail);
+			for(bytes -= tail; bytes >= width; bytes -= width)
+				step(dst + bytes - width, src + bytes - width);
+			memmove(dst, src, bytes);
+		}
+		_mm_sfence();
+	}
+
+	inline void stream_move_sse2(char* dst, const char* src, 
+								size_type bytes) noexcept
+	{
+		stream_move_<16>(dst, src, bytes, [](char* d, const char* s) {
+			_mm_stream_si128((__m128i*) d, _mm_loadu_si128((const __m128i*) s));
+		});
+	}
+
+	__attribute__((target("avx")))
+	inline void stream_move_avx(char* dst, const char* src, 
+								size_type bytes) noexcept
+	{
+		stream_move_<32>(dst, src, bytes, 
+			[](char* d, const char* s) __attribute__((target("avx"))) {
+				_mm256_stream_si256((__m256i*) d, 
+									_mm256_loadu_si256((const __m256i*) s));
+			});
+	}
+
+	inline bool has_avx() noexcept
+	{
+		static const bool avx = __builtin_cpu_supports("avx");
+		return avx;
+	}
+#endif
+
+	// memmove with non-temporal stores, AVX or SSE2 as the CPU allows.
+	inline void stream_move(void* dst, const void* src, size_type bytes) noexcept
+	{
+#if defined(__x86_64__)
+		if(has_avx())
+			stream_move_avx((char*) dst, (const char*) src, bytes);
+		else
+			stream_move_sse2((char*) dst, (const char*) src, bytes);
+#else
+		memmove(dst, src, bytes);
+#endif
+	}
+
+	// Fills n copies of value with non-temporal stores. Element sizes that
+	// do not divide 16 bytes, or misaligned data, take a plain fill.
 	template<typename T>
-	T_Copy<T> fill(T* data, size_type n, const T& value = T())
+	void stream_fill(T* data, size_type n, const T& value) noexcept
 	{
+#if defined(__x86_64__)
+		const size_type width = sizeof(__m128i);
+		if constexpr(width % sizeof(T) == 0)
+		{
+			if((size_type) data % sizeof(T) == 0)
+			{
+				size_type head = std::min(
+						((0 - (size_type) data) & (width - 1)) / sizeof(T), n);
+				std::uninitialized_fill_n(data, head, value);
+				data += head, n -= head;
+				char pattern[width];
+				for(size_type i = 0; i < width; i += sizeof(T))
+					memcpy(pattern + i, &value, sizeof(T));
+				__m128i v = _mm_loadu_si128((const __m128i*) pattern);
+				size_type count = n * sizeof(T) / width;
+				for(size_type i = 0; i < count; ++i)
+					_mm_stream_si128((__m128i*) data + i, v);
+				_mm_sfence();
+				size_type done = count * width / sizeof(T);
+				std::uninitialized_fill_n(data + done, n - done, value);
+				return;
+			}
+		}
+#endif
 		std::uninitialized_fill_n(data, n, value);
 	}
 
-	template<typename T>
+	template<typename P>
+	constexpr bool streams(size_type bytes)
+	{
+		return P::stream_bytes > 0 and bytes >= P::stream_bytes;
+	}
+
+	// memmove, streaming from P::stream_bytes.
+	template<typename P>
+	void move_bytes(void* dst, const void* src, size_type bytes) noexcept
+	{
+		if(streams<P>(bytes))
+			stream_move(dst, src, bytes);
+		else
+			memmove(dst, src, bytes);
+	}
+
+// fill
+	template<typename P = default_policy, typename T>
+	T_Copy<T> fill(T* data, size_type n, const T& value = T())
+	{
+		if(streams<P>(n*sizeof(T)))
+			stream_fill(data, n, value);
+		else
+			std::uninitialized_fill_n(data, n, value);
+	}
+
+	template<typename P = default_policy, typename T>
 	NT_Copy<T> fill(T* data, size_type n, const T& value = T())
 	{
 		std::uninitialized_fill_n(data, n, value);
 	}
 
-	template<typename T, typename InputIterator>
+	template<typename P = default_policy, typename T, typename InputIterator>
 	T_Copy<T> fill(T* data, InputIterator begin, InputIterator end)
 	{
-		memcpy(data, &*begin, (end - begin) * sizeof(T)); 
+		if(streams<P>((end - begin) * sizeof(T)))
+			stream_move(data, &*begin, (end - begin) * sizeof(T));
+		else
+			memcpy(data, &*begin, (end - begin) * sizeof(T)); 
 	}
 
-	template<typename T, typename InputIterator>
+	template<typename P = default_policy, typename T, typename InputIterator>
 	NT_Copy<T> fill(T* data, InputIterator begin, InputIterator end)
 	{
 		std::uninitialized_copy(begin, end, data);
 	}
 
+// parallel
+	// Runs f(i) for every i in [0, n) on up to threads std::threads, the
+	// calling one included. Any type with such a bulk member, say a
+	// wrapper around a thread pool, can stand in for it; f never throws.
+	class thread_executor
+	{
+	public:
+		explicit thread_executor(
+					unsigned threads = std::thread::hardware_concurrency())
+		 : threads_(std::max(threads, 1u))
+		{
+		}
+
+		template<typename F>
+		void bulk(size_type n, F f)
+		{
+			std::atomic<size_type> next(0);
+			auto work = [&] {
+				for(size_type i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;)
+					f(i);
+			};
+			std::vector<std::thread> workers;
+			for(size_type t = 1; t < std::min<size_type>(threads_, n); ++t)
+				try
+				{
+					workers.emplace_back(work);
+				}
+				catch(const std::system_error&)
+				{
+					break;
+				}
+			work();
+			for(auto& worker : workers)
+				worker.join();
+		}
+
+	private:
+		unsigned threads_;
+	};
+
+	template<typename E, typename = void>
+	struct is_executor : std::false_type
+	{
+	};
+
+	template<typename E>
+	struct is_executor<E, std::void_t<decltype(std::declval<E&>().bulk(
+						size_type(), std::declval<void(*)(size_type)>()))>>
+	 : std::true_type
+	{
+	};
+
+	template<typename E>
+	using Executor = std::enable_if_t<is_executor<E>::value>;
+
+	// Elements of a parallel fill go to tasks in runs between addresses
+	// that are multiples of parallel_chunk, whole huge pages, so tasks share
+	// a page of a mapped block only through an element straddling one of
+	// those addresses.
+	constexpr size_type parallel_chunk = 4 << 20;
+
+	// Constructs the n elements at data with init(offset, count) over chunks
+	// run by ex, or in one call below P::parallel_bytes. init cleans up its
+	// own chunk as the std::uninitialized_ algorithms do; when one throws,
+	// the chunks built are destroyed and the first exception is rethrown.
+	template<typename T, typename P, typename E, typename F>
+	void parallel_init(E& ex, T* data, size_type n, F init)
+	{
+		if(n*sizeof(T) < P::parallel_bytes)
+			return init(size_type(0), n);
+		size_type bytes = n*sizeof(T);
+		size_type head = parallel_chunk - (uintptr_t) data % parallel_chunk;
+		size_type chunks = 1 + (bytes > head ? 
+							(bytes - head + parallel_chunk - 1) / parallel_chunk : 0);
+		// First element of chunk i, the first to start at or past its
+		// aligned address.
+		auto first = [&](size_type i) {
+			if(i == 0) 
+				return size_type(0);
+			size_type at = head + (i - 1) * parallel_chunk;
+			return std::min(n, (at + sizeof(T) - 1) / sizeof(T));
+		};
+		std::vector<std::exception_ptr> errors(chunks);
+		ex.bulk(chunks, [&](size_type i) noexcept {
+			size_type from = first(i);
+			try
+			{
+				init(from, first(i + 1) - from);
+			}
+			catch(...)
+			{
+				errors[i] = std::current_exception();
+			}
+		});
+		auto failed = std::find_if(errors.begin(), errors.end(), 
+								[](const std::exception_ptr& e) { return bool(e); });
+		if(failed == errors.end()) return;
+		for(size_type i = 0; i < chunks; ++i)
+			if(!errors[i])
+				destruct(data + first(i), data + first(i + 1));
+		std::rethrow_exception(*failed);
+	}
+
+	template<typename T, typename P, typename E>
+	void parallel_fill(E& ex, T* data, size_type n, const T& value = T())
+	{
+		parallel_init<T, P>(ex, data, n, [&](size_type from, size_type count) {
+			mm::fill<P>(data + from, count, value);
+		});
+	}
+
+	template<typename T, typename P, typename E, typename RandomIt>
+	void parallel_copy(E& ex, T* data, RandomIt first, size_type n)
+	{
+		parallel_init<T, P>(ex, data, n, [&](size_type from, size_type count) {
+			mm::fill<P>(data + from, first + from, first + from + count);
+		});
+	}
+
+// zero
+	// Whether storage of P past the capacity a mapped block had, and all of
+	// a new one, reads as zero. Cached mappings keep their old contents and
+	// copy on write files their clones' pages, so those policies fill.
+	template<typename T, typename P>
+	constexpr bool zero_mapped()
+	{
+		return is_zero_initializable<T>::value and !P::uses_resource and 
+				!cached<P>() and !P::copy_on_write;
+	}
+
+	// Value-initializes elements [from, to) of a block grown from
+	// old_capacity. Only the elements on the pages below old_capacity may
+	// hold stale bytes when the block is mapped and zero_mapped: a shrunk
+	// block keeps the old contents of its last, partial page.
+	template<typename P, typename T>
+	void value_fill(T* data, size_type from, size_type to, 
+					size_type old_capacity)
+	{
+		if constexpr(zero_mapped<T, P>())
+			if(data and is_mapped<T, P>(to))
+			{
+				size_type stale = (page_round<P>(old_capacity*sizeof(T)) + 
+									sizeof(T) - 1) / sizeof(T);
+				to = std::max(from, std::min(to, stale));
+			}
+		fill<P>(data + from, to - from);
+	}
+
 // fix_capacity
-	template <typename T>
+	template <typename T, typename P = default_policy>
 	size_type fix_capacity(size_type n)
 	{
-		if(n < map_threshold<T>)
+		size_type threshold = P::template map_threshold<T>();
+		if(n < threshold)
 	        return std::max(64/sizeof(T), n);
-	    return map_threshold<T> * (n/map_threshold<T> + 1);
+	    if constexpr(P::huge_pages)
+	    	if(n >= P::template huge_threshold<T>())
+	    		return huge_round(n*sizeof(T)) / sizeof(T);
+	    return threshold * (n/threshold + 1);
 	}
 
 // realloc
-	template<typename T>
-	T_Move<T, T*> realloc_(T* data, 
+	// mremap timed for telemetry.
+	template<typename T, typename P>
+	void* remap_(T* data, size_type old_bytes, size_type new_bytes, int flags,
+				void* dst = nullptr)
+	{
+		return telemetry::timed<T>(telemetry::sys_mremap, [&] {
+			return mremap(data, old_bytes, new_bytes, flags, dst);
+		});
+	}
+
+	// mremap that keeps huge page alignment: when the block cannot grow in
+	// place it is moved onto an aligned range reserved by map_.
+	template<typename T, typename P>
+	void* remap_(T* data, size_type old_bytes, size_type new_bytes)
+	{
+		if constexpr(!P::huge_pages)
+			return remap_<T, P>(data, old_bytes, new_bytes, MREMAP_MAYMOVE);
+		else
+		{
+			void* p = remap_<T, P>(data, old_bytes, new_bytes, 0);
+			if(p != MAP_FAILED)
+				return p;
+			void* dst = map_<T, P>(new_bytes, PROT_NONE,
+							MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE);
+			p = remap_<T, P>(data, old_bytes, new_bytes, 
+						MREMAP_MAYMOVE | MREMAP_FIXED, dst);
+			if(UNLIKELY(p == MAP_FAILED))
+				munmap(dst, new_bytes);
+			return p;
+		}
+	}
+
+	// Resizes within the reserved range of a mapped block. Returns false when
+	// the mode is off or n does not fit; in the latter case the whole range is
+	// committed first, so it is a single mapping that mremap can extend.
+	template<typename T, typename P>
+	bool remap_reserved(T* data, size_type capacity, size_type n)
+	{
+		if constexpr(P::reserve_bytes > 0)
+		{
+			if(n*sizeof(T) > reserved_size<P>())
+			{
+				commit<T, P>(data, capacity, n);
+				return false;
+			}
+			if(capacity*sizeof(T) > reserved_size<P>())
+				remap_<T, P>(data, capacity*sizeof(T), reserved_size<P>(), 0);
+			if(n < capacity)
+				decommit<T, P>(data, n, capacity);
+			else
+				commit<T, P>(data, capacity, n);
+			telemetry::add<T>(telemetry::inplace_remaps);
+			return true;
+		}
+		return false;
+	}
+
+	template<typename T, typename P = default_policy>
+	T_Reloc<T, T*> realloc_(T* data, 
 							size_type length, 
 							size_type capacity, 
 							size_type n)
 	{
-		if((n > map_threshold<T>) != (capacity > map_threshold<T>))
+		using namespace telemetry;
+		if constexpr(P::uses_resource)
+			return resource_realloc(data, length, capacity, n);
+		if(is_mapped<T, P>(n) != is_mapped<T, P>(capacity))
 	    {
-	        T* new_data = allocate<T>(n);
-	        memcpy(new_data, data, length * sizeof(T));
-	        deallocate(data, capacity);
+	        T* new_data = allocate<T, P>(n);
+	        move_bytes<P>(new_data, data, length * sizeof(T));
+	        deallocate<T, P>(data, capacity);
+	        add<T>(map_transitions, is_mapped<T, P>(n));
+	        add<T>(fallback_copies);
+	        add<T>(bytes_copied, length * sizeof(T));
 	        return new_data;
 	    }
 	    else
 	    {
-	        if(capacity > map_threshold<T>)
-            	return (T*) mremap(data, capacity*sizeof(T), 
-                        		n*sizeof(T), MREMAP_MAYMOVE);
+	        if(is_mapped<T, P>(capacity))
+	        {
+	        	if(remap_reserved<T, P>(data, capacity, n))
+	        		return data;
+	        	if constexpr(P::copy_on_write)
+	        	{
+	        		void* p = cow_remap<T, P>(data, mapped_size<T, P>(capacity),
+	        					mapped_size<T, P>(n), length*sizeof(T), 
+	        					MREMAP_MAYMOVE);
+	        		if(UNLIKELY(p == MAP_FAILED))
+	        			throw std::bad_alloc();
+	        		add<T>(p == data ? inplace_remaps : page_moves);
+	        		return (T*) p;
+	        	}
+            	void* new_data = remap_<T, P>(data, 
+            					mapped_size<T, P>(capacity), 
+                        		mapped_size<T, P>(n));
+                if(LIKELY(new_data != MAP_FAILED))
+                {
+                	add<T>(new_data == data ? inplace_remaps : page_moves);
+                	return (T*) new_data;
+                }
+                // A block made of several mappings, as steal_pages leaves
+                // it, cannot be remapped as a whole.
+                T* copy = allocate<T, P>(n);
+                move_bytes<P>(copy, data, length * sizeof(T));
+                deallocate<T, P>(data, capacity);
+                add<T>(fallback_copies);
+                add<T>(bytes_copied, length * sizeof(T));
+                return copy;
+	        }
 	        else
-	        	return (T*) realloc(data, n*sizeof(T));
+	        {
+	        	T* new_data = (T*) realloc((void*) data, n*sizeof(T));
+	        	if(new_data != data)
+	        	{
+	        		add<T>(fallback_copies);
+	        		add<T>(bytes_copied, length * sizeof(T));
+	        	}
+	        	return new_data;
+	        }
 	    }
 	}
 
-	template<typename T>
-	NT_Move<T, T*> realloc_(T* data, 
+	template<typename T, typename P = default_policy>
+	NT_Reloc<T, T*> realloc_(T* data, 
 							size_type length, 
 							size_type capacity, 
 							size_type n)
 	{
-        if(capacity > map_threshold<T>)
+		using namespace telemetry;
+		if constexpr(P::uses_resource)
+			return resource_realloc(data, length, capacity, n);
+        if(is_mapped<T, P>(capacity) and is_mapped<T, P>(n))
         {
-            void* new_data = mremap(data, capacity*sizeof(T), 
-                        		n*sizeof(T), 0);
+        	if(remap_reserved<T, P>(data, capacity, n))
+        		return data;
+            void* new_data;
+            if constexpr(P::copy_on_write)
+            	new_data = cow_remap<T, P>(data, mapped_size<T, P>(capacity), 
+            				mapped_size<T, P>(n), length*sizeof(T), 0);
+            else
+            	new_data = remap_<T, P>(data, mapped_size<T, P>(capacity), 
+                        		mapped_size<T, P>(n), 0);
             if(new_data != (void*)-1)
+            {
+            	add<T>(inplace_remaps);
             	return (T*) new_data;
+            }
         }
-	    T* new_data = allocate<T>(n);
+	    T* new_data = allocate<T, P>(n);
 	    std::uninitialized_move_n(data, length, new_data);
 	    destruct(data, data + length);
-	    deallocate(data, capacity);
+	    deallocate<T, P>(data, capacity);
+	    add<T>(map_transitions, 
+	    		is_mapped<T, P>(n) and !is_mapped<T, P>(capacity));
+	    add<T>(fallback_copies);
+	    add<T>(bytes_copied, length * sizeof(T));
 	    return new_data;
 	}
 
+// clone
+	// Storage holding a copy of the length elements at src, with the same
+	// capacity, copied in parallel on ex. Copy on write policies share the
+	// pages of mapped blocks.
+	template<typename T, typename P, typename E>
+	T* clone(E& ex, const T* src, size_type length, size_type capacity)
+	{
+		if constexpr(P::copy_on_write and std::is_trivially_copyable<T>::value)
+			if(src and is_mapped<T, P>(capacity))
+				return (T*) cow_clone<T, P>((void*) src, 
+								mapped_size<T, P>(capacity), length*sizeof(T));
+		T* data = allocate<T, P>(capacity);
+		try
+		{
+			parallel_copy<T, P>(ex, data, src, length);
+		}
+		catch(...)
+		{
+			deallocate<T, P>(data, capacity);
+			throw;
+		}
+		return data;
+	}
+
+	template<typename T, typename P = default_policy>
+	T* clone(const T* src, size_type length, size_type capacity)
+	{
+		return clone<T, P>(P::executor(), src, length, capacity);
+	}
+
 // change_capacity
-	template<typename T>
+	template<typename T, typename P = default_policy>
 	void change_capacity(T*& data, 
 						size_type length, 
 						size_type& capacity, 
 						size_type n)
 	{
-		size_type new_capacity = fix_capacity<T>(n);
-		if(UNLIKELY(new_capacity < map_threshold<T> and capacity > map_threshold<T>))
+		size_type new_capacity = fix_capacity<T, P>(n);
+		if(UNLIKELY((!is_mapped<T, P>(new_capacity) and is_mapped<T, P>(capacity))))
 			return;
 	    if(data)
-	        data = realloc_(data, length, capacity, new_capacity);
+	        data = realloc_<T, P>(data, length, capacity, new_capacity);
 	    else
-	        data = allocate<T>(new_capacity);
+	        data = allocate<T, P>(new_capacity);
+	    if constexpr(P::prefault_mode != prefault::none)
+	    	if(new_capacity > capacity and is_mapped<T, P>(new_capacity))
+	    		populate<P>(data, length*sizeof(T), new_capacity*sizeof(T), 
+	    					P::prefault_mode, P::prefault_budget);
 	    capacity = new_capacity;
 	}
 
+// steal
+	template<typename P>
+	constexpr bool plain_mapping()
+	{
+		return !P::huge_pages and P::reserve_bytes == 0 and 
+				!P::copy_on_write and !P::uses_resource;
+	}
+
+	// Appends the src_length elements of a mapped source block to data by
+	// moving its pages behind the length elements with mremap. Pages only
+	// move whole, so this needs length elements to end on a page boundary;
+	// it returns false otherwise and leaves the source alone. On success the
+	// source block is consumed.
+	template<typename T, typename P = default_policy>
+	bool steal_pages(T*& data, size_type length, size_type& capacity,
+					T* src, size_type src_length, size_type src_capacity)
+	{
+		if constexpr(!is_trivially_relocatable<T>::value or !plain_mapping<P>())
+			return false;
+		else
+		{
+			using namespace telemetry;
+			if(!is_mapped<T, P>(src_capacity) or 
+				length*sizeof(T) % P::page_size())
+				return false;
+			size_type n = length + src_length;
+			if(n > capacity)
+				change_capacity<T, P>(data, length, capacity, 
+								std::max(n, P::template grow<T>(capacity)));
+			if(!is_mapped<T, P>(capacity))
+				return false;
+			size_type bytes = page_round<P>(src_length*sizeof(T));
+			char* dst = (char*) data + length*sizeof(T);
+			void* p = remap_<T, P>(src, bytes, bytes, 
+								MREMAP_MAYMOVE | MREMAP_FIXED, dst);
+			if(UNLIKELY(p == MAP_FAILED))
+			{
+				// mremap may have unmapped the target range already.
+				mmap(dst, bytes, PROT_READ | PROT_WRITE, 
+					MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+				return false;
+			}
+			size_type src_bytes = page_round<P>(mapped_size<T, P>(src_capacity));
+			if(src_bytes > bytes)
+				munmap((char*) src + bytes, src_bytes - bytes);
+			add<T>(page_moves);
+			return true;
+		}
+	}
+
+// shift
+	constexpr size_type remap_shift_min = 1 << 20;
+	constexpr size_type map_count_period = 64;
+
+	inline size_type count_maps() noexcept
+	{
+		int fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+		if(fd < 0) return 0;
+		char buffer[16 << 10];
+		size_type lines = 0;
+		ssize_t n;
+		while((n = read(fd, buffer, sizeof(buffer))) > 0)
+			lines += std::count(buffer, buffer + n, '\n');
+		close(fd);
+		return lines;
+	}
+
+	// Mappings of the process, recounted every map_count_period calls.
+	inline size_type map_count() noexcept
+	{
+		static std::atomic<size_type> calls(0);
+		static std::atomic<size_type> count(0);
+		if(calls.fetch_add(1, std::memory_order_relaxed) % map_count_period == 0)
+			count.store(count_maps(), std::memory_order_relaxed);
+		return count.load(std::memory_order_relaxed);
+	}
+
+	template<typename P>
+	size_type shift_max_maps() noexcept
+	{
+		if constexpr(P::shift_max_maps > 0)
+			return P::shift_max_maps;
+		static const size_type limit = [] {
+			size_type max = 65530;
+			int fd = open("/proc/sys/vm/max_map_count", O_RDONLY | O_CLOEXEC);
+			if(fd >= 0)
+			{
+				char buffer[32] = {};
+				if(read(fd, buffer, sizeof(buffer) - 1) > 0)
+					max = strtoul(buffer, nullptr, 10);
+				close(fd);
+			}
+			return max / 2;
+		}();
+		return limit;
+	}
+
+	// Whether shift_tail may move n elements' worth of a tail of length
+	// elements by remapping pages. The shift has to be whole pages so every
+	// page keeps its offset, the tail long enough to beat a memmove, and
+	// the process short of shift_max_maps mappings.
+	template<typename T, typename P = default_policy>
+	bool remap_shiftable(size_type capacity, size_type n, size_type length) noexcept
+	{
+		if constexpr(!is_trivially_relocatable<T>::value or !plain_mapping<P>())
+			return false;
+		return is_mapped<T, P>(capacity) and n*sizeof(T) % P::page_size() == 0
+				and length*sizeof(T) >= remap_shift_min
+				and map_count() < shift_max_maps<P>();
+	}
+
+	// Relocates elements [first, last) by `by` positions within a mapped
+	// block. The pages from the first page boundary on move with two
+	// mremap calls through a scratch range, as source and target may
+	// overlap; the partial page in front is copied and the pages left
+	// behind are mapped afresh before the moved ones land. If a mapping
+	// call fails the pages go back and the elements are memmoved instead.
+	// A left shift copies the partial page first, before the moved pages
+	// land on it; a right shift copies it last, into the refilled range.
+	// The block stays split into several mappings; growth copies it into
+	// a single one again.
+	template<typename T, typename P = default_policy>
+	void shift_tail(T* data, size_type first, size_type last, std::ptrdiff_t by)
+	{
+		char* base = (char*) data;
+		size_type begin = first*sizeof(T);
+		size_type end = last*sizeof(T);
+		size_type shift = (by < 0 ? -by : by) * sizeof(T);
+		size_type pages = page_round<P>(begin);
+		size_type pages_end = std::max(pages, page_round<P>(end));
+		size_type bytes = pages_end - pages;
+		char* src = base + pages;
+		char* dst = by > 0 ? src + shift : src - shift;
+		auto fallback = [&] {
+			move_bytes<P>(base + begin + (by > 0 ? shift : -shift), 
+						base + begin, end - begin);
+		};
+		if(by < 0)
+			memcpy(base + begin - shift, base + begin, pages - begin);
+		if(!bytes)
+			return fallback();
+		void* scratch = mmap(NULL, bytes, PROT_NONE, 
+						MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if(UNLIKELY(scratch == MAP_FAILED))
+			return fallback();
+		if(remap_<T, P>((T*) src, bytes, bytes, 
+						MREMAP_MAYMOVE | MREMAP_FIXED, scratch) == MAP_FAILED)
+		{
+			munmap(scratch, bytes);
+			return fallback();
+		}
+		// What the pages leave and the target does not cover.
+		char* hole = by > 0 ? src : std::max(src, dst + bytes);
+		char* hole_end = by > 0 ? std::min(src + bytes, dst) : src + bytes;
+		if(mmap(hole, hole_end - hole, PROT_READ | PROT_WRITE, 
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED or
+			remap_<T, P>((T*) scratch, bytes, bytes, 
+						MREMAP_MAYMOVE | MREMAP_FIXED, dst) == MAP_FAILED)
+		{
+			// Put the pages back, or copy them back when the process is
+			// out of mappings for mremap, and remap what a failed mremap
+			// may have unmapped of the target: spare capacity of a right
+			// shift, the erased and already copied bytes of a left one.
+			// Without a way back the elements in scratch are lost.
+			const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+			char* outside = by > 0 ? std::max(dst, src + bytes) : dst;
+			char* outside_end = by > 0 ? dst + bytes : std::min(dst + bytes, src);
+			if(remap_<T, P>((T*) scratch, bytes, bytes, 
+						MREMAP_MAYMOVE | MREMAP_FIXED, src) == MAP_FAILED)
+			{
+				if(mmap(src, bytes, PROT_READ | PROT_WRITE, flags, -1, 0) 
+						== MAP_FAILED)
+					std::terminate();
+				memcpy(src, scratch, bytes);
+				munmap(scratch, bytes);
+			}
+			if(outside < outside_end and mmap(outside, outside_end - outside, 
+						PROT_READ | PROT_WRITE, flags, -1, 0) == MAP_FAILED)
+				std::terminate();
+			if(by > 0)
+				return fallback();
+			move_bytes<P>(dst, src, end - pages);
+			return;
+		}
+		if(by > 0)
+			memcpy(base + begin + shift, base + begin, pages - begin);
+		telemetry::add<T>(telemetry::page_moves);
+	}
+
+// grow_gap
+	template<typename P, typename T>
+	void relocate_n(T* from, size_type n, T* to)
+	{
+		if constexpr(is_trivially_relocatable<T>::value)
+			move_bytes<P>(to, from, n * sizeof(T));
+		else
+		{
+			std::uninitialized_move_n(from, n, to);
+			destruct(from, from + n);
+		}
+	}
+
+	// Grows the block to n elements without copying them: in place through
+	// an extendable resource, or by remapping a mapped block. Returns false,
+	// leaving the block alone, when only a copy would do.
+	template<typename T, typename P = default_policy>
+	bool grow_pages(T*& data, size_type length, size_type& capacity, size_type n)
+	{
+		using namespace telemetry;
+		if constexpr(P::uses_resource)
+		{
+			auto r = dynamic_cast<extendable_resource*>(resource_of(data));
+			if(!r or !r->extend((char*) data - resource_header, 
+								resource_header + capacity*sizeof(T),
+								resource_header + n*sizeof(T)))
+				return false;
+			add<T>(inplace_remaps);
+		}
+		else
+		{
+			if(!is_mapped<T, P>(capacity) or !is_mapped<T, P>(n))
+				return false;
+			if(!remap_reserved<T, P>(data, capacity, n))
+			{
+				void* p;
+				if constexpr(P::copy_on_write)
+					p = cow_remap<T, P>(data, mapped_size<T, P>(capacity),
+								mapped_size<T, P>(n), length*sizeof(T), 
+								MREMAP_MAYMOVE);
+				else
+					p = remap_<T, P>(data, mapped_size<T, P>(capacity), 
+									mapped_size<T, P>(n));
+				if(p == MAP_FAILED)
+					return false;
+				add<T>(p == data ? inplace_remaps : page_moves);
+				data = (T*) p;
+			}
+			if constexpr(P::prefault_mode != prefault::none)
+				populate<P>(data, length*sizeof(T), n*sizeof(T), 
+							P::prefault_mode, P::prefault_budget);
+		}
+		capacity = n;
+		return true;
+	}
+
+	// Grows the block for n more elements and opens an uninitialized gap of
+	// n elements at position, moving every element once. Relocatable types
+	// in blocks that grow_pages can extend only move their tail; otherwise
+	// the prefix and the tail go straight to their places in a new block.
+	// Returns the gap.
+	template<typename T, typename P = default_policy>
+	T* grow_gap(T*& data, size_type length, size_type& capacity, 
+				size_type position, size_type n)
+	{
+		using namespace telemetry;
+		size_type wanted = std::max(length + n, P::template grow<T>(capacity));
+		size_type new_capacity = fix_capacity<T, P>(wanted);
+		if(!data)
+		{
+			data = allocate<T, P>(new_capacity);
+			capacity = new_capacity;
+			return data;
+		}
+		if(is_trivially_relocatable<T>::value and 
+			grow_pages<T, P>(data, length, capacity, new_capacity))
+		{
+			if(remap_shiftable<T, P>(capacity, n, length - position))
+				shift_tail<T, P>(data, position, length, n);
+			else
+				move_bytes<P>(data + position + n, data + position,
+							(length - position) * sizeof(T));
+			return data + position;
+		}
+		T* new_data;
+		if constexpr(P::uses_resource)
+			new_data = resource_allocate<T>(resource_of(data), new_capacity);
+		else
+			new_data = allocate<T, P>(new_capacity);
+		relocate_n<P>(data, position, new_data);
+		relocate_n<P>(data + position, length - position, new_data + position + n);
+		deallocate<T, P>(data, capacity);
+		add<T>(map_transitions, 
+				is_mapped<T, P>(new_capacity) and !is_mapped<T, P>(capacity));
+		add<T>(fallback_copies);
+		add<T>(bytes_copied, length * sizeof(T));
+		data = new_data;
+		capacity = new_capacity;
+		return data + position;
+	}
+
+// shrink
+	// Shrinks a mapped block to n elements where it lies, so it never moves
+	// elements and cannot fail. Returns the new capacity.
+	template<typename T, typename P = default_policy>
+	size_type shrink_mapped(T* data, size_type capacity, size_type n) noexcept
+	{
+		n = std::max(fix_capacity<T, P>(n), 
+					fix_capacity<T, P>(P::template map_threshold<T>()));
+		if(n >= capacity)
+			return capacity;
+		if(!remap_reserved<T, P>(data, capacity, n))
+			remap_<T, P>(data, mapped_size<T, P>(capacity), 
+						mapped_size<T, P>(n), 0);
+		return n;
+	}
+
+	template<typename T, typename P = default_policy>
+	void shrink(T*& data, size_type length, size_type& capacity)
+	{
+		if(is_mapped<T, P>(capacity) and 
+			is_mapped<T, P>(fix_capacity<T, P>(length)))
+			capacity = shrink_mapped<T, P>(data, capacity, length);
+		else if(data and fix_capacity<T, P>(length) < capacity)
+		{
+			size_type new_capacity = fix_capacity<T, P>(length);
+			data = realloc_<T, P>(data, length, capacity, new_capacity);
+			capacity = new_capacity;
+		}
+	}
+
+// release
+	// Hands whole pages past length back to the kernel. The range stays
+	// mapped, so the capacity is unchanged.
+	template<typename T, typename P = default_policy>
+	void release(T* data, size_type length, size_type capacity) noexcept
+	{
+		if(!is_mapped<T, P>(capacity)) return;
+		size_type from = page_round<P>(length*sizeof(T));
+		size_type to = page_round<P>(capacity*sizeof(T));
+		if constexpr(P::reserve_bytes > 0)
+			if(capacity*sizeof(T) <= reserved_size<P>())
+				to = std::min(to, reserved_size<P>());
+		if(from < to)
+			madvise((char*) data + from, to - from, P::release_advice);
+	}
+
+	// Applies the policy's auto shrink and page release after the vector
+	// dropped from old_length to length elements.
+	template<typename T, typename P = default_policy>
+	void trim(T* data, size_type old_length, size_type length, 
+			size_type& capacity) noexcept
+	{
+		if constexpr(P::shrink_ratio == 0 and P::release_bytes == 0)
+			return;
+		if(!is_mapped<T, P>(capacity)) return;
+		if constexpr(P::shrink_ratio > 0)
+			if(length * P::shrink_ratio < capacity)
+			{
+				capacity = shrink_mapped<T, P>(data, capacity, 
+											length * P::shrink_ratio / 2);
+				return;
+			}
+		if constexpr(P::release_bytes > 0)
+			if((old_length - length) * sizeof(T) >= P::release_bytes or
+				length * sizeof(T) / P::release_bytes != 
+					old_length * sizeof(T) / P::release_bytes)
+				release<T, P>(data, length, capacity);
+	}
+
 // grow
-	template<typename T>
+	template<typename T, typename P = default_policy>
 	void grow(T*& data, size_type length, size_type& capacity)
 	{
 		if(LIKELY(length < capacity)) return;
-		change_capacity(data, length, capacity, capacity*2 + 1);
+		change_capacity<T, P>(data, length, capacity, 
+							P::template grow<T>(capacity));
 	}
 
 // TODO: check if policies are sufficient
 // shiftr data
-	template<typename T>
-	T_Move_a<T> 
+	template<typename P = default_policy, typename T>
+	T_Reloc<T> 
 	shiftr_data(T* begin, size_type end)
 	{
-		memmove(begin + 1, begin, end * sizeof(T));
+		move_bytes<P>(begin + 1, begin, end * sizeof(T));
 	}
 
-	template<typename T>
-	NT_Move_a<T> 
+	template<typename P = default_policy, typename T>
+	NT_Reloc<T> 
 	shiftr_data(T* begin, size_type end)
 	{
+		if(end == 0) return;
 		auto end_p = begin + end;
 		new (end_p) T(std::move(*(end_p - 1)));
 		std::move_backward(begin, end_p - 1, end_p);
@@ -6,13 +6,30 @@
 #include <map>
 #include <math.h>
 #include <fstream>
+#include <filesystem>
+#include <sstream>
 #include "rvector.h"
+#include "concurrent_rvector.h"
+#include "traced_rvector.h"
 #include "test_type.h"
+#ifdef RVECTOR_HAVE_FOLLY
 #include <folly/FBVector.h>
+#endif
+#ifdef RVECTOR_HAVE_BOOST
 #include <boost/container/vector.hpp>
+#endif
+#ifdef RVECTOR_HAVE_EASTL
 #include <EASTL/vector.h>
+#endif
 #include <new>
+#include <malloc.h>
+#include <sys/resource.h>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <unordered_map>
 
+#ifdef RVECTOR_HAVE_EASTL
 void* operator new[](size_t size, const char* pName, int flags, unsigned debugFlags, const char* file, int line) {
 	return malloc(size);
 }
@@ -21,6 +38,7 @@ void* operator new[](size_t size, size_t alignment, size_t alignmentOffset, cons
 {
     return malloc(size);
 }  
+#endif
 
 template<typename T, typename F>
 auto map(F f, std::vector<T> const& v) -> decltype(auto) {
@@ -93,11 +111,202 @@ public:
 std::map<std::string, double> BenchTimer::durations = {};
 std::vector<std::map<std::string, double>> BenchTimer::data = {};
 
-void check_mremap()
+template <typename T>
+void check_mremap(std::string const& name)
 {
-	std::cout << mm::mremap_skips << " " << mm::grows << std::endl;
-	mm::mremap_skips = 0;
-	mm::grows = 0;
+	if constexpr(mm::telemetry::enabled) {
+		std::cout << name << std::endl << mm::telemetry::snapshot<T>();
+		mm::telemetry::reset<T>();
+	}
+}
+
+struct huge_policy : mm::basic_policy<huge_policy>
+{
+	static constexpr bool huge_pages = true;
+};
+
+long minor_faults()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_minflt;
+}
+
+template <typename Policy>
+void huge_pages_bench(std::string name, size_t count = 1 << 27) {
+	rvector<int, Policy> v;
+	long faults = minor_faults();
+	double fill_time, scan_time, gather_time;
+	{
+		BenchTimer bt(name + " fill");
+		for(size_t i = 0; i < count; ++i)
+			v.push_back(i);
+		fill_time = bt.check();
+	}
+	faults = minor_faults() - faults;
+
+	long sum = 0;
+	{
+		BenchTimer bt(name + " scan");
+		for(auto const& e : v)
+			sum += e;
+		scan_time = bt.check();
+	}
+	{
+		BenchTimer bt(name + " gather");
+		size_t idx = 0;
+		for(size_t i = 0; i < count; ++i) {
+			idx = (idx * 6364136223846793005ull + 1442695040888963407ull) % count;
+			sum += v[idx];
+		}
+		gather_time = bt.check();
+	}
+	double gb = count * sizeof(int) / double(1 << 30);
+	std::cout << name << ": " << faults << " minor faults, "
+			<< "fill " << fill_time << "s, "
+			<< "scan " << gb / scan_time << " GiB/s, "
+			<< "gather " << gather_time << "s "
+			<< "(" << sum << ")" << std::endl;
+}
+
+struct cache_policy : mm::basic_policy<cache_policy>
+{
+	static constexpr size_t cache_bytes = 256 << 20;
+};
+
+// Short-lived large vectors, as in construct_action and copy_action.
+template <typename Policy>
+void mapping_churn_bench(std::string name, int it_count = 10000) {
+	double time;
+	long sum = 0;
+	{
+		BenchTimer bt(name + " churn");
+		for(int i = 0; i < it_count; ++i) {
+			rvector<int, Policy> v(size_t(1 << 14) << (i % 4), i);
+			rvector<int, Policy> copy(v);
+			sum += copy.back();
+		}
+		time = bt.check();
+	}
+	std::cout << name << " churn: " << time << "s (" << sum << ")" << std::endl;
+	check_mremap<int>(name);
+}
+
+struct stream_policy : mm::basic_policy<stream_policy>
+{
+	static constexpr size_t stream_bytes = 32 << 20;
+};
+
+// Lookups over a hot table that fits the LLC, run beside fills and copies
+// of a vector far larger than it; streaming stores should leave the
+// table cached.
+template <typename Policy>
+void cache_pressure_bench(std::string name, size_t count = 1 << 27, 
+						int it_count = 10) {
+	std::vector<unsigned> hot(1 << 20);
+	for(size_t i = 0; i < hot.size(); ++i)
+		hot[i] = (i * 2654435761u) % hot.size();
+	std::atomic<bool> done(false);
+	long lookups = 0;
+	unsigned idx = 0;
+	std::thread reader([&] {
+		while(!done.load(std::memory_order_relaxed)) {
+			for(int i = 0; i < 1024; ++i)
+				idx = hot[idx ^ i];
+			lookups += 1024;
+		}
+	});
+	double time;
+	long sum = 0;
+	{
+		rvector<int, Policy> v(count), copy(count);
+		BenchTimer bt(name + " stream");
+		for(int i = 0; i < it_count; ++i) {
+			v.assign(count, i);
+			copy = v;
+			sum += copy.back();
+		}
+		time = bt.check();
+	}
+	done = true;
+	reader.join();
+	double gb = 2.0 * it_count * count * sizeof(int) / double(1 << 30);
+	std::cout << name << ": fill+copy " << gb / time << " GiB/s, "
+			<< "hot lookups " << lookups / time / 1e6 << "M/s "
+			<< "(" << sum + idx << ")" << std::endl;
+}
+
+// Appends from 1 to all cores into one array, through concurrent_rvector
+// and through a mutex around rvector::push_back.
+void concurrent_append_bench(size_t count = 1 << 25) {
+	unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+	auto run = [&](unsigned threads, auto push) {
+		std::vector<std::thread> producers;
+		auto begin = std::chrono::steady_clock::now();
+		for(unsigned t = 0; t < threads; ++t)
+			producers.emplace_back([&, t] {
+				for(size_t i = t; i < count; i += threads)
+					push(i);
+			});
+		for(auto& producer : producers)
+			producer.join();
+		return std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - begin).count();
+	};
+	for(unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+		concurrent_rvector<size_t> events(count);
+		double lock_free = run(threads, [&](size_t i) { events.push_back(i); });
+		rvector<size_t> locked_events;
+		std::mutex lock;
+		double locked = run(threads, [&](size_t i) {
+			std::lock_guard<std::mutex> guard(lock);
+			locked_events.push_back(i);
+		});
+		std::cout << "append " << threads << " producers: "
+				<< "concurrent_rvector " << count / lock_free / 1e6 << "M/s, "
+				<< "mutex rvector " << count / locked / 1e6 << "M/s" << std::endl;
+		if(threads == cores)
+			break;
+	}
+}
+
+std::string prefault_name(mm::prefault mode)
+{
+	switch(mode) {
+		case mm::prefault::populate: return "populate";
+		case mm::prefault::chunked: return "chunked";
+		default: return "none";
+	}
+}
+
+// Per push_back latency after a reserve, to show where the page faults land.
+void push_back_latency_bench(mm::prefault mode, size_t count = 1 << 24) {
+	using Clock = std::chrono::steady_clock;
+	std::string name = "rvector<int> reserve " + prefault_name(mode);
+	rvector<int> v;
+	std::vector<long> latency(count);
+	long faults = minor_faults();
+	double reserve_time;
+	{
+		BenchTimer bt(name);
+		v.reserve(count, mode, std::chrono::milliseconds(10));
+		reserve_time = bt.check();
+	}
+	long reserve_faults = minor_faults() - faults;
+	faults = minor_faults();
+	for(size_t i = 0; i < count; ++i) {
+		auto begin = Clock::now();
+		v.push_back(i);
+		latency[i] = std::chrono::nanoseconds(Clock::now() - begin).count();
+	}
+	faults = minor_faults() - faults;
+	std::sort(latency.begin(), latency.end());
+	auto pct = [&](double p) { return latency[size_t(p * (count - 1))]; };
+	std::cout << name << ": reserve " << reserve_time << "s, "
+			<< reserve_faults << "/" << faults << " faults in reserve/append, "
+			<< "push_back p50 " << pct(0.5) << "ns p99 " << pct(0.99) 
+			<< "ns p99.99 " << pct(0.9999) << "ns max " << latency.back() 
+			<< "ns" << std::endl;
 }
 
 template <template<typename> typename V, typename... Ts>
@@ -315,11 +524,32 @@ private:
 	int seed;
 };
 
+// Command line of the comparison; see usage().
+struct options {
+	std::string out = "data";
+	std::vector<std::string> types = {"int", "string", "TestType", "array", "mixed"};
+	int iterations = 0;
+	size_t push_backs = 1000000000;
+	int seed = 12345512;
+	int runs = 10;
+	bool rvector_benches = true;
+	std::string replay;
+
+	bool has_type(std::string const& type) const {
+		return std::find(types.begin(), types.end(), type) != types.end();
+	}
+
+	std::string path(std::string const& dir, std::string const& name) const {
+		std::filesystem::create_directories(out + "/" + dir);
+		return out + "/" + dir + "/" + name + ".csv";
+	}
+};
+
 template <template<typename> typename V, typename... Ts>
-void experiment(std::string name, int max_it = 1000, int tests = 10) {
+void experiment(std::string name, options const& opt, int max_it = 1000) {
 	malloc_trim(0);
 	BenchTimer::data.resize(max_it / 100);
-	for(int seed = 12345512; seed < 12345512 + tests; seed++) {
+	for(int seed = opt.seed; seed < opt.seed + opt.runs; seed++) {
 		VectorEnv<V, Ts...> v_env(seed);
 		v_env.RunSimulation(max_it);
 		BenchTimer::clear();
@@ -334,7 +564,7 @@ void experiment(std::string name, int max_it = 1000, int tests = 10) {
 				<< data[i]["Simulation"] << "s" << std::endl;
 	}
 
-	std::ofstream out("data/additional/add2/" + name + ".csv");
+	std::ofstream out(opt.path("experiment", name));
 
 	out << "iterations";
 	for(auto const& [k, v] : data[0]) {
@@ -355,29 +585,133 @@ void experiment(std::string name, int max_it = 1000, int tests = 10) {
 	}
 }
 
+#ifdef RVECTOR_HAVE_BOOST
 using boost_gf = boost::container::growth_factor_100;
 using boost_options = boost::container::vector_options_t<boost::container::growth_factor<boost_gf>>;
 
 template<typename T>
 using boost_vector = boost::container::vector<T, boost::container::new_allocator<T>, boost_options>; 
+#endif
+
+// Baseline: a doubling array grown with plain realloc, as a C program
+// would do it. Only for trivially relocatable types.
+template<typename T>
+class realloc_vector {
+	static_assert(mm::is_trivially_relocatable<T>::value,
+				"realloc_vector moves elements with realloc");
+public:
+	realloc_vector() = default;
+	realloc_vector(realloc_vector const&) = delete;
+	realloc_vector& operator=(realloc_vector const&) = delete;
+	~realloc_vector() {
+		std::destroy(begin(), end());
+		free(data_);
+	}
+
+	T* begin() { return data_; }
+	T* end() { return data_ + size_; }
+	T& operator[](size_t n) { return data_[n]; }
+	T& back() { return data_[size_ - 1]; }
+	size_t size() const { return size_; }
+	size_t capacity() const { return capacity_; }
+
+	template<typename... Args>
+	void emplace_back(Args&&... args) {
+		if(size_ == capacity_)
+			reserve(std::max<size_t>(capacity_ * 2, 1));
+		new (data_ + size_) T(std::forward<Args>(args)...);
+		++size_;
+	}
+
+	void pop_back() { data_[--size_].~T(); }
+
+	void assign(T* first, T* last) {
+		std::destroy(begin(), end());
+		size_ = 0;
+		reserve(last - first);
+		std::uninitialized_copy(first, last, data_);
+		size_ = last - first;
+	}
+
+	T* insert(T* pos, size_t n, T const& value) {
+		size_t i = pos - data_;
+		T copy = value;
+		if(size_ + n > capacity_)
+			reserve(std::max(size_ + n, capacity_ * 2));
+		memmove((void*) (data_ + i + n), data_ + i, (size_ - i) * sizeof(T));
+		std::uninitialized_fill_n(data_ + i, n, copy);
+		size_ += n;
+		return data_ + i;
+	}
+
+	T* erase(T* first, T* last) {
+		std::destroy(first, last);
+		memmove((void*) first, last, (end() - last) * sizeof(T));
+		size_ -= last - first;
+		return first;
+	}
+
+	void reserve(size_t n) {
+		if(n <= capacity_) return;
+		T* data = (T*) realloc((void*) data_, n * sizeof(T));
+		if(!data) throw std::bad_alloc();
+		data_ = data;
+		capacity_ = n;
+	}
+
+	void resize(size_t n) {
+		if(n < size_)
+			std::destroy(data_ + n, end());
+		else {
+			reserve(n);
+			std::uninitialized_value_construct(end(), data_ + n);
+		}
+		size_ = n;
+	}
+
+	void shrink_to_fit() {
+		if(size_ == capacity_) return;
+		if(size_ == 0) {
+			free(data_);
+			data_ = nullptr;
+		}
+		else if(T* data = (T*) realloc((void*) data_, size_ * sizeof(T)))
+			data_ = data;
+		else
+			return;
+		capacity_ = size_;
+	}
+
+private:
+
+	T* data_ = nullptr;
+	size_t size_ = 0;
+	size_t capacity_ = 0;
+};
+
+namespace mm {
+	template<typename T>
+	struct is_trivially_relocatable<realloc_vector<T>> : std::true_type {};
+}
 
 template <template<typename> typename V, typename T>
-void push_back_bench(std::string name, int it_count = 1000000000) {
-	BenchTimer::data.resize(6);
+void push_back_bench(std::string name, options const& opt) {
+	BenchTimer::data.clear();
 	int e = 0;
-	for(int i = 1000; i < it_count; i *= 10) {
+	for(size_t i = 1000; i < opt.push_backs; i *= 10) {
+		BenchTimer::data.resize(e + 1);
 		{
 			BenchTimer bt("push_back");
 			for(int t = 0; t < 10; t++) {
 				V<T> v;
-				for(int it = 0; it < i; it++)
+				for(size_t it = 0; it < i; it++)
 					v.emplace_back();
 			}
 		}
 		BenchTimer::save_epoch(e++);
 		BenchTimer::clear();
 	}
-	std::ofstream out("data/simple/" + name + ".csv");
+	std::ofstream out(opt.path("simple", name));
 
 	out << "push_back_count,time" << std::endl;
 	auto data = BenchTimer::data;
@@ -394,47 +728,307 @@ void push_back_bench(std::string name, int it_count = 1000000000) {
 	BenchTimer::clear_data();
 }
 
-int main()
+// Every competitor built in, on one element type or type mix.
+template <typename... Ts>
+void compare(std::string const& type, options const& opt, int max_it) {
+	if(opt.iterations)
+		max_it = opt.iterations;
+	auto name = [&](std::string const& vector) { return vector + "<" + type + ">"; };
+	experiment<rvector, Ts...>(name("rvector"), opt, max_it);
+	(check_mremap<Ts>(name("rvector")), ...);
+	(check_mremap<rvector<Ts>>(name("rvector<rvector") + ">"), ...);
+	experiment<std::vector, Ts...>(name("std::vector"), opt, max_it);
+	if constexpr((mm::is_trivially_relocatable<Ts>::value && ...))
+		experiment<realloc_vector, Ts...>(name("realloc_vector"), opt, max_it);
+#ifdef RVECTOR_HAVE_FOLLY
+	experiment<folly::fbvector, Ts...>(name("folly::fbvector"), opt, max_it);
+#endif
+#ifdef RVECTOR_HAVE_BOOST
+	experiment<boost_vector, Ts...>(name("boost_vector"), opt, max_it);
+#endif
+#ifdef RVECTOR_HAVE_EASTL
+	experiment<eastl::vector, Ts...>(name("eastl::vector"), opt, max_it);
+#endif
+}
+
+template <typename T>
+void compare_push_back(std::string const& type, options const& opt) {
+	auto name = [&](std::string const& vector) { return vector + "<" + type + ">"; };
+	push_back_bench<rvector, T>(name("rvector"), opt);
+	push_back_bench<std::vector, T>(name("std::vector"), opt);
+	if constexpr(mm::is_trivially_relocatable<T>::value)
+		push_back_bench<realloc_vector, T>(name("realloc_vector"), opt);
+#ifdef RVECTOR_HAVE_FOLLY
+	push_back_bench<folly::fbvector, T>(name("folly::fbvector"), opt);
+#endif
+#ifdef RVECTOR_HAVE_EASTL
+	push_back_bench<eastl::vector, T>(name("eastl::vector"), opt);
+#endif
+#ifdef RVECTOR_HAVE_BOOST
+	push_back_bench<boost_vector, T>(name("boost_vector"), opt);
+#endif
+}
+
+// Elements of a replayed trace are blobs of the recorded size rounded up
+// to a power of two, at most 256 bytes.
+template<size_t N>
+struct blob {
+	unsigned char bytes[N];
+};
+
+template <template<typename> typename V>
+class trace_replay {
+	using op = mm::trace::op;
+	static constexpr size_t buckets = 9;
+
+	template<size_t I>
+	using vectors = std::unordered_map<uint64_t, V<blob<size_t(1) << I>>>;
+
+	template<size_t... I>
+	static auto make_vectors(std::index_sequence<I...>) {
+		return std::tuple<vectors<I>...>();
+	}
+
+public:
+	void apply(mm::trace::record const& r) {
+		if(r.code == op::construct) {
+			size_t b = 0;
+			while(b + 1 < buckets && (size_t(1) << b) < r.a)
+				++b;
+			bucket_of[r.id] = b;
+		}
+		else if(r.code == op::copy)
+			bucket_of[r.id] = bucket(r.a);
+		visit(bucket(r.id), [&](auto& vectors) { apply(vectors, r); },
+			std::make_index_sequence<buckets>());
+		if(r.code == op::destroy)
+			bucket_of.erase(r.id);
+	}
+
+private:
+	size_t bucket(uint64_t id) const {
+		auto it = bucket_of.find(id);
+		if(it == bucket_of.end())
+			throw std::runtime_error("trace uses vector " + std::to_string(id) +
+									" before constructing it");
+		return it->second;
+	}
+
+	template<typename F, size_t... I>
+	void visit(size_t b, F&& f, std::index_sequence<I...>) {
+		((b == I ? f(std::get<I>(vectors_)) : void()), ...);
+	}
+
+	template<typename Vectors>
+	static void apply(Vectors& vectors, mm::trace::record const& r) {
+		if(r.code == op::destroy) {
+			vectors.erase(r.id);
+			return;
+		}
+		auto& v = vectors[r.id];
+		using T = std::remove_reference_t<decltype(*v.begin())>;
+		size_t size = v.size();
+		switch(r.code) {
+			case op::copy: {
+				auto& source = vectors.at(r.a);
+				v.assign(source.begin(), source.end());
+				break;
+			}
+			case op::reserve: v.reserve(r.a); break;
+			case op::resize: v.resize(r.a); break;
+			case op::assign:
+				v.erase(v.begin(), v.end());
+				v.resize(r.a);
+				break;
+			case op::push_back:
+				for(uint64_t i = 0; i < r.a; ++i)
+					v.emplace_back();
+				break;
+			case op::pop_back:
+				for(uint64_t i = 0; i < std::min<uint64_t>(r.a, size); ++i)
+					v.pop_back();
+				break;
+			case op::insert:
+				v.insert(v.begin() + std::min<uint64_t>(r.a, size), r.b, T());
+				break;
+			case op::erase: {
+				auto first = v.begin() + std::min<uint64_t>(r.a, size);
+				v.erase(first, first + std::min<uint64_t>(r.b, v.end() - first));
+				break;
+			}
+			case op::shrink_to_fit: v.shrink_to_fit(); break;
+			default: break;
+		}
+	}
+
+	decltype(make_vectors(std::make_index_sequence<buckets>())) vectors_;
+	std::unordered_map<uint64_t, size_t> bucket_of;
+};
+
+// Runs the whole trace on V, timing each kind of operation.
+template <template<typename> typename V>
+void replay_bench(std::string name, std::vector<mm::trace::record> const& records,
+				options const& opt) {
+	using Clock = std::chrono::steady_clock;
+	constexpr size_t ops = size_t(mm::trace::op::ops);
+	const char* op_names[ops] = {"construct", "copy", "destroy", "reserve",
+		"resize", "assign", "push_back", "pop_back", "insert", "erase",
+		"shrink_to_fit"};
+	double time[ops] = {};
+	size_t count[ops] = {};
+	malloc_trim(0);
+	{
+		trace_replay<V> replay;
+		for(auto const& r : records) {
+			auto begin = Clock::now();
+			replay.apply(r);
+			time[size_t(r.code)] += std::chrono::duration<double>(Clock::now() - begin).count();
+			++count[size_t(r.code)];
+		}
+	}
+	double total = std::accumulate(time, time + ops, 0.0);
+	std::cout << name << " replay: " << total << "s" << std::endl;
+
+	std::ofstream out(opt.path("replay", name));
+	out << "op,count,time" << std::endl;
+	for(size_t i = 0; i < ops; ++i)
+		out << op_names[i] << "," << count[i] << "," << time[i] << std::endl;
+}
+
+// Policy variants to tune on a trace; add your own next to these.
+template<typename T>
+using rvector_huge = rvector<T, huge_policy>;
+template<typename T>
+using rvector_cache = rvector<T, cache_policy>;
+
+void compare_replay(options const& opt) {
+	std::vector<mm::trace::record> records;
+	mm::trace::reader trace(opt.replay);
+	for(mm::trace::record r; trace.next(r);)
+		records.push_back(r);
+	std::cout << opt.replay << ": " << records.size() << " records" << std::endl;
+
+	replay_bench<rvector>("rvector", records, opt);
+	replay_bench<rvector_huge>("rvector<huge_policy>", records, opt);
+	replay_bench<rvector_cache>("rvector<cache_policy>", records, opt);
+	replay_bench<std::vector>("std::vector", records, opt);
+	replay_bench<realloc_vector>("realloc_vector", records, opt);
+#ifdef RVECTOR_HAVE_FOLLY
+	replay_bench<folly::fbvector>("folly::fbvector", records, opt);
+#endif
+#ifdef RVECTOR_HAVE_BOOST
+	replay_bench<boost_vector>("boost_vector", records, opt);
+#endif
+#ifdef RVECTOR_HAVE_EASTL
+	replay_bench<eastl::vector>("eastl::vector", records, opt);
+#endif
+}
+
+void usage(char const* argv0) {
+	std::cerr << "usage: " << argv0 << " [options]\n"
+		<< "  --out DIR          write CSVs under DIR (default data)\n"
+		<< "  --types LIST       comma separated: int,string,TestType,array,mixed\n"
+		<< "  --iterations N     simulation steps per experiment, a multiple of 100\n"
+		<< "                     (default per type: 3000, 1500 or 1200, 1000 mixed)\n"
+		<< "  --push-backs N     largest push_back count, exclusive (default 1e9)\n"
+		<< "  --seed S           first simulation seed (default 12345512)\n"
+		<< "  --runs N           seeds per experiment (default 10)\n"
+		<< "  --compare-only     skip the rvector-only benchmarks\n"
+		<< "  --replay TRACE     only replay a traced_rvector trace on each competitor\n"
+		<< "competitors:"
+		<< " rvector std::vector realloc_vector"
+#ifdef RVECTOR_HAVE_FOLLY
+		<< " folly::fbvector"
+#endif
+#ifdef RVECTOR_HAVE_BOOST
+		<< " boost_vector"
+#endif
+#ifdef RVECTOR_HAVE_EASTL
+		<< " eastl::vector"
+#endif
+		<< std::endl;
+}
+
+bool parse(int argc, char** argv, options& opt) {
+	for(int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if(arg == "--compare-only") {
+			opt.rvector_benches = false;
+			continue;
+		}
+		if(i + 1 == argc)
+			return false;
+		std::string value = argv[++i];
+		try {
+			if(arg == "--out") opt.out = value;
+			else if(arg == "--replay") opt.replay = value;
+			else if(arg == "--iterations") opt.iterations = std::stoi(value);
+			else if(arg == "--push-backs") opt.push_backs = std::stoull(value);
+			else if(arg == "--seed") opt.seed = std::stoi(value);
+			else if(arg == "--runs") opt.runs = std::stoi(value);
+			else if(arg == "--types") {
+				opt.types.clear();
+				std::istringstream list(value);
+				for(std::string type; std::getline(list, type, ',');)
+					opt.types.push_back(type);
+			}
+			else return false;
+		}
+		catch(std::exception const&) {
+			return false;
+		}
+	}
+	return opt.iterations >= 0 && opt.runs > 0;
+}
+
+int main(int argc, char** argv)
 {
-	push_back_bench<rvector, int>("rvector<int>");
-	push_back_bench<std::vector, int>("std::vector<int>");
-	push_back_bench<folly::fbvector, int>("folly::fbvector<int>");
-	push_back_bench<eastl::vector, int>("eastl::vector<int>");
-	push_back_bench<boost_vector, int>("boost_vector<int>");
-
-	push_back_bench<rvector, std::string>("rvector<std::string>");
-	push_back_bench<std::vector, std::string>("std::vector");
-	push_back_bench<folly::fbvector, std::string>("folly::fbvector");
-	push_back_bench<eastl::vector, std::string>("eastl::vector");
-	push_back_bench<boost_vector, std::string>("boost_vector");
-
-	experiment<std::vector, int>("std::vector<int>", 3000);
-	experiment<rvector, int>("rvector<int>", 3000);
-	experiment<folly::fbvector, int>("folly::fbvector<int>", 3000);
-	experiment<boost_vector, int>("boost_vector<int>", 3000);
-	experiment<eastl::vector, int>("eastl::vector<int>", 3000);
-	
-	experiment<rvector, TestType>("rvector<TestType>", 1500);
-	experiment<std::vector, TestType>("std::vector<TestType>", 1500);
-	experiment<folly::fbvector, TestType>("folly::fbvector<TestType>", 1500);
-	experiment<boost_vector, TestType>("boost_vector<TestType>", 1500);
-	experiment<eastl::vector, TestType>("eastl::vector<TestType>", 1500);
-	
-	experiment<rvector, std::string>("rvector<std::string>", 1200);
-	experiment<std::vector, std::string>("std::vector<std::string>", 1200);
-	experiment<folly::fbvector, std::string>("folly::fbvector<std::string>", 1200);
-	experiment<boost_vector, std::string>("boost_vector<std::string>", 1200);
-	experiment<eastl::vector, std::string>("eastl::vector<std::string>", 1200);
-
-	experiment<rvector, std::array<int, 10>>("rvector<std::array<int,10>>", 1200);
-	experiment<std::vector, std::array<int, 10>>("std::vector<std::array<int,10>>", 1200);
-	experiment<folly::fbvector,  std::array<int, 10>>("folly::fbvector<std::array<int,10>>", 1200);
-	experiment<boost_vector,  std::array<int, 10>>("boost_vector<std::array<int,10>>", 1200);
-	experiment<eastl::vector,  std::array<int, 10>>("eastl::vector<std::array<int,10>>", 1200);
-	
-	experiment<std::vector, std::string, int, std::array<int, 10>>("std::vector<std::string, int, std::array<int,10>>", 1000);
-	experiment<rvector, std::string, int, std::array<int, 10>>("rvector<std::string, int, std::array<int,10>>", 1000);
-	experiment<folly::fbvector, std::string, int, std::array<int, 10>>("folly::fbvector<std::string, int, std::array<int,10>>", 1000);
-	experiment<boost_vector, std::string, int, std::array<int, 10>>("boost_vector<std::string, int, std::array<int,10>>", 1000);
-	experiment<eastl::vector, std::string, int, std::array<int, 10>>("eastl::vector<std::string, int, std::array<int,10>>", 1000);
-}
\ No newline at end of file
+	options opt;
+	if(!parse(argc, argv, opt)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if(!opt.replay.empty()) {
+		try {
+			compare_replay(opt);
+		}
+		catch(std::runtime_error const& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	if(opt.rvector_benches) {
+		huge_pages_bench<mm::default_policy>("rvector<int>");
+		huge_pages_bench<huge_policy>("rvector<int, huge_policy>");
+
+		for(auto mode : {mm::prefault::none, mm::prefault::chunked, mm::prefault::populate})
+			push_back_latency_bench(mode);
+
+		mapping_churn_bench<mm::default_policy>("rvector<int>");
+		mapping_churn_bench<cache_policy>("rvector<int, cache_policy>");
+
+		cache_pressure_bench<mm::default_policy>("rvector<int>");
+		cache_pressure_bench<stream_policy>("rvector<int, stream_policy>");
+
+		concurrent_append_bench();
+	}
+
+	if(opt.has_type("int"))
+		compare_push_back<int>("int", opt);
+	if(opt.has_type("string"))
+		compare_push_back<std::string>("std::string", opt);
+
+	if(opt.has_type("int"))
+		compare<int>("int", opt, 3000);
+	if(opt.has_type("TestType"))
+		compare<TestType>("TestType", opt, 1500);
+	if(opt.has_type("string"))
+		compare<std::string>("std::string", opt, 1200);
+	if(opt.has_type("array"))
+		compare<std::array<int, 10>>("std::array<int,10>", opt, 1200);
+	if(opt.has_type("mixed"))
+		compare<std::string, int, std::array<int, 10>>("std::string, int, std::array<int,10>", opt, 1000);
+}
@@ -0,0 +1,264 @@
+#pragma once
+#include <sys/mman.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "allocator.h"
+
+// Append-only vector for many producers. The address space for max_size
+// elements is reserved up front and committed in growing steps, so
+// elements never move. Producers claim a slot with one fetch_add and
+// construct in place; only a claim past the committed pages takes a lock.
+// A byte per slot marks it constructed, and size() publishes the prefix
+// of marked slots, so readers see fully built elements only. A constructor
+// that throws leaves its slot unmarked and size() stops in front of it.
+template<typename T, typename Policy = mm::default_policy>
+class concurrent_rvector
+{
+public:
+	using value_type = T;
+	using size_type = size_t;
+
+	using reference = T&;
+	using const_reference = const T&;
+
+	using iterator = T*;
+	using const_iterator = const T*;
+
+    explicit concurrent_rvector(size_type max_size);
+    concurrent_rvector(const concurrent_rvector&) = delete;
+    concurrent_rvector& operator =(const concurrent_rvector&) = delete;
+    ~concurrent_rvector();
+
+    // Safe from any number of threads. Return the index of the element.
+    template <class... Args>
+    size_type emplace_back(Args&&... args);
+    size_type push_back(const T& x);
+    size_type push_back(T&& x);
+
+    // Elements [0, size()) are constructed and visible to the caller.
+    size_type size() const noexcept;
+    size_type capacity() const noexcept;
+    bool empty() const noexcept;
+
+	iterator begin() noexcept;
+	const_iterator begin() const noexcept;
+	iterator end() noexcept;
+    const_iterator end() const noexcept;
+
+    reference operator[](size_type n);
+    const_reference operator[](size_type n) const;
+    reference at(size_type n);
+    const_reference at(size_type n) const;
+
+    T* data() noexcept;
+    const T* data() const noexcept;
+private:
+    static constexpr size_type commit_step = 1 << 20;
+
+    void commit(size_type n);
+
+    T* data_;
+    std::atomic<unsigned char>* ready_;
+    size_type capacity_;
+    std::atomic<size_type> claimed_;
+    std::atomic<size_type> committed_;
+    mutable std::atomic<size_type> published_;
+    std::mutex commit_lock_;
+};
+
+template<typename T, typename Policy>
+concurrent_rvector<T, Policy>::concurrent_rvector(size_type max_size)
+ : data_(nullptr),
+ ready_(nullptr),
+ capacity_(max_size),
+ claimed_(0),
+ committed_(0),
+ published_(0)
+{
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    data_ = (T*) mm::map_<T, Policy>(
+                mm::page_round<Policy>(capacity_*sizeof(T)), PROT_NONE, flags);
+    try
+    {
+        ready_ = (std::atomic<unsigned char>*) mm::map_<T, Policy>(
+                    mm::page_round<Policy>(capacity_), PROT_NONE, flags);
+    }
+    catch(...)
+    {
+        munmap(data_, mm::page_round<Policy>(capacity_*sizeof(T)));
+        throw;
+    }
+}
+
+template<typename T, typename Policy>
+concurrent_rvector<T, Policy>::~concurrent_rvector()
+{
+    size_type n = std::min(claimed_.load(), committed_.load());
+    if constexpr(!std::is_trivially_destructible<T>::value)
+        for(size_type i = 0; i < n; ++i)
+            if(ready_[i].load(std::memory_order_acquire))
+                data_[i].~T();
+    munmap(data_, mm::page_round<Policy>(capacity_*sizeof(T)));
+    munmap(ready_, mm::page_round<Policy>(capacity_));
+}
+
+// Commits pages for at least n elements, doubling the committed range and
+// prefaulting it as the policy asks.
+template<typename T, typename Policy>
+void concurrent_rvector<T, Policy>::commit(size_type n)
+{
+    std::lock_guard<std::mutex> guard(commit_lock_);
+    size_type from = committed_.load(std::memory_order_relaxed);
+    if(n <= from) return;
+    size_type to = std::max({n, from * 2, commit_step / sizeof(T)});
+    to = std::min(to, capacity_);
+    size_type data_from = mm::page_round<Policy>(from*sizeof(T));
+    size_type data_to = mm::page_round<Policy>(to*sizeof(T));
+    size_type ready_from = mm::page_round<Policy>(from);
+    size_type ready_to = mm::page_round<Policy>(to);
+    if(UNLIKELY(mprotect((char*) data_ + data_from, data_to - data_from,
+                         PROT_READ | PROT_WRITE) or
+                mprotect((char*) ready_ + ready_from, ready_to - ready_from,
+                         PROT_READ | PROT_WRITE)))
+        throw std::bad_alloc();
+    mm::populate<Policy>(data_, data_from, data_to, Policy::prefault_mode,
+                         Policy::prefault_budget);
+    committed_.store(to, std::memory_order_release);
+}
+
+template<typename T, typename Policy>
+template <class... Args>
+typename concurrent_rvector<T, Policy>::size_type
+concurrent_rvector<T, Policy>::emplace_back(Args&&... args)
+{
+    size_type i = claimed_.fetch_add(1, std::memory_order_relaxed);
+    if(UNLIKELY(i >= capacity_))
+        throw std::length_error("concurrent_rvector: full at " +
+                                std::to_string(capacity_));
+    if(UNLIKELY(i >= committed_.load(std::memory_order_acquire)))
+        commit(i + 1);
+    new (data_ + i) T(std::forward<Args>(args)...);
+    ready_[i].store(1, std::memory_order_release);
+    return i;
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::size_type
+concurrent_rvector<T, Policy>::push_back(const T& x)
+{
+    return emplace_back(x);
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::size_type
+concurrent_rvector<T, Policy>::push_back(T&& x)
+{
+    return emplace_back(std::move(x));
+}
+
+// Extends the published prefix over the slots marked since, and publishes
+// it for the next reader. Acquiring the marks makes the elements visible.
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::size_type
+concurrent_rvector<T, Policy>::size() const noexcept
+{
+    size_type n = published_.load(std::memory_order_acquire);
+    size_type limit = std::min(claimed_.load(std::memory_order_relaxed),
+                               committed_.load(std::memory_order_acquire));
+    size_type end = n;
+    while(end < limit and ready_[end].load(std::memory_order_acquire))
+        ++end;
+    while(n < end and !published_.compare_exchange_weak(n, end,
+                                std::memory_order_release,
+                                std::memory_order_acquire));
+    return std::max(n, end);
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::size_type
+concurrent_rvector<T, Policy>::capacity() const noexcept
+{
+    return capacity_;
+}
+
+template<typename T, typename Policy>
+bool concurrent_rvector<T, Policy>::empty() const noexcept
+{
+    return size() == 0;
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::iterator
+concurrent_rvector<T, Policy>::begin() noexcept
+{
+    return data_;
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::const_iterator
+concurrent_rvector<T, Policy>::begin() const noexcept
+{
+    return data_;
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::iterator
+concurrent_rvector<T, Policy>::end() noexcept
+{
+    return data_ + size();
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::const_iterator
+concurrent_rvector<T, Policy>::end() const noexcept
+{
+    return data_ + size();
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::reference
+concurrent_rvector<T, Policy>::operator[](size_type n)
+{
+    return data_[n];
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::const_reference
+concurrent_rvector<T, Policy>::operator[](size_type n) const
+{
+    return data_[n];
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::reference
+concurrent_rvector<T, Policy>::at(size_type n)
+{
+    if(UNLIKELY(n >= size()))
+        throw std::out_of_range("Index out of range: " + std::to_string(n));
+    return data_[n];
+}
+
+template<typename T, typename Policy>
+typename concurrent_rvector<T, Policy>::const_reference
+concurrent_rvector<T, Policy>::at(size_type n) const
+{
+    if(UNLIKELY(n >= size()))
+        throw std::out_of_range("Index out of range: " + std::to_string(n));
+    return data_[n];
+}
+
+template<typename T, typename Policy>
+T* concurrent_rvector<T, Policy>::data() noexcept
+{
+    return data_;
+}
+
+template<typename T, typename Policy>
+const T* concurrent_rvector<T, Policy>::data() const noexcept
+{
+    return data_;
+}
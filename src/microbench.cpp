@@ -0,0 +1,358 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "rvector.h"
+#include "snapshot_rvector.h"
+#include "test_type.h"
+
+// Microbenchmarks of single rvector operations per element type and size
+// tier. Each one reports wall time, cycles, instructions, page faults,
+// context switches and syscalls from perf_event_open, falling back to
+// getrusage where perf events are not allowed, plus the mmap, mremap and
+// munmap calls counted by the allocator telemetry. Results are JSON.
+//
+//   runMicrobenchmarks [output.json] [filter]
+
+// One perf event per counter; a missing one reads as null.
+class perf_counters
+{
+public:
+	enum event { cycles, instructions, page_faults, context_switches,
+				syscalls, events };
+
+	struct sample
+	{
+		std::optional<uint64_t> value[events];
+	};
+
+	perf_counters()
+	{
+		open(cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		open(instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		open(page_faults, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+		open(context_switches, PERF_TYPE_SOFTWARE,
+			PERF_COUNT_SW_CONTEXT_SWITCHES);
+		if(auto id = tracepoint_id("raw_syscalls/sys_enter"))
+			open(syscalls, PERF_TYPE_TRACEPOINT, *id);
+	}
+
+	~perf_counters()
+	{
+		for(int fd : fds)
+			if(fd >= 0)
+				close(fd);
+	}
+
+	const char* source() const
+	{
+		return fds[page_faults] >= 0 ? "perf_event" : "getrusage";
+	}
+
+	void start()
+	{
+		for(int fd : fds)
+			if(fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		getrusage(RUSAGE_THREAD, &usage);
+	}
+
+	sample stop()
+	{
+		sample s;
+		for(int e = 0; e < events; ++e)
+			if(fds[e] >= 0)
+			{
+				ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+				uint64_t value;
+				if(read(fds[e], &value, sizeof(value)) == sizeof(value))
+					s.value[e] = value;
+			}
+		rusage now;
+		getrusage(RUSAGE_THREAD, &now);
+		if(!s.value[page_faults])
+			s.value[page_faults] = (now.ru_minflt - usage.ru_minflt) +
+									(now.ru_majflt - usage.ru_majflt);
+		if(!s.value[context_switches])
+			s.value[context_switches] = (now.ru_nvcsw - usage.ru_nvcsw) +
+										(now.ru_nivcsw - usage.ru_nivcsw);
+		return s;
+	}
+
+private:
+	void open(event e, uint32_t type, uint64_t config)
+	{
+		perf_event_attr attr = {};
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = type == PERF_TYPE_HARDWARE;
+		attr.exclude_hv = 1;
+		fds[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+
+	static std::optional<uint64_t> tracepoint_id(const std::string& name)
+	{
+		for(const char* root : {"/sys/kernel/tracing/events/",
+								"/sys/kernel/debug/tracing/events/"})
+		{
+			std::ifstream in(root + name + "/id");
+			uint64_t id;
+			if(in >> id)
+				return id;
+		}
+		return std::nullopt;
+	}
+
+	int fds[events] = {-1, -1, -1, -1, -1};
+	rusage usage;
+};
+
+template<typename T> T make(size_t i);
+template<> int make<int>(size_t i) { return i; }
+template<> std::string make<std::string>(size_t i)
+{
+	return "element number " + std::to_string(i);
+}
+template<> std::array<int, 10> make<std::array<int, 10>>(size_t i)
+{
+	std::array<int, 10> a;
+	a.fill(i);
+	return a;
+}
+template<> TestType make<TestType>(size_t i) { return TestType(i, i); }
+
+template<typename T>
+rvector<T> filled(size_t n)
+{
+	rvector<T> v;
+	v.reserve(n);
+	for(size_t i = 0; i < n; ++i)
+		v.push_back(make<T>(i));
+	return v;
+}
+
+struct result
+{
+	std::string operation;
+	std::string type;
+	std::string tier;
+	size_t elements;
+	size_t repetitions;
+	double ns;
+	perf_counters::sample counters;
+	mm::telemetry::stats telemetry;
+};
+
+class suite
+{
+public:
+	explicit suite(std::string filter) : filter(filter) {}
+
+	// Runs op on repetitions states made by setup, timing op alone.
+	template<typename T, typename Setup, typename Op>
+	void run(const std::string& operation, const std::string& type,
+			const std::string& tier, size_t n, size_t repetitions,
+			Setup setup, Op op)
+	{
+		std::string name = operation + " " + type + " " + tier;
+		if(name.find(filter) == std::string::npos)
+			return;
+		std::vector<decltype(setup())> states;
+		for(size_t r = 0; r < repetitions; ++r)
+			states.push_back(setup());
+		mm::telemetry::reset<T>();
+		auto begin = std::chrono::steady_clock::now();
+		counters.start();
+		for(auto& state : states)
+			op(state);
+		perf_counters::sample sample = counters.stop();
+		double ns = std::chrono::duration<double, std::nano>(
+						std::chrono::steady_clock::now() - begin).count();
+		results.push_back(result{operation, type, tier, n, repetitions,
+								ns / repetitions, sample,
+								mm::telemetry::snapshot<T>()});
+		std::cerr << name << ": " << ns / repetitions << " ns" << std::endl;
+	}
+
+	void write(std::ostream& out) const
+	{
+		const char* events[] = {"cycles", "instructions", "page_faults",
+								"context_switches", "syscalls"};
+		const char* calls[] = {"mmap", "mremap", "munmap"};
+		const char* counts[] = {"inplace_remaps", "page_moves",
+										"fallback_copies", "bytes_copied"};
+		out << "{\n  \"counter_source\": \"" << counters.source() << "\",\n"
+			<< "  \"telemetry\": " << (mm::telemetry::enabled ? "true" : "false")
+			<< ",\n  \"benchmarks\": [";
+		for(size_t i = 0; i < results.size(); ++i)
+		{
+			const result& r = results[i];
+			out << (i ? "," : "") << "\n    {\"operation\": \"" << r.operation
+				<< "\", \"type\": \"" << r.type << "\", \"tier\": \"" << r.tier
+				<< "\", \"elements\": " << r.elements
+				<< ", \"repetitions\": " << r.repetitions
+				<< ", \"ns\": " << r.ns;
+			for(size_t e = 0; e < perf_counters::events; ++e)
+			{
+				out << ", \"" << events[e] << "\": ";
+				if(r.counters.value[e])
+					out << double(*r.counters.value[e]) / r.repetitions;
+				else
+					out << "null";
+			}
+			for(size_t c = 0; c < mm::telemetry::syscalls; ++c)
+			{
+				uint64_t count = 0;
+				for(uint64_t bucket : r.telemetry.latency[c])
+					count += bucket;
+				out << ", \"" << calls[c] << "\": "
+					<< double(count) / r.repetitions;
+			}
+			for(auto c : {mm::telemetry::inplace_remaps, 
+						mm::telemetry::page_moves, mm::telemetry::fallback_copies, 
+						mm::telemetry::bytes_copied})
+				out << ", \"" << counts[c] << "\": "
+					<< double(r.telemetry.count[c]) / r.repetitions;
+			out << "}";
+		}
+		out << "\n  ]\n}\n";
+	}
+
+private:
+	std::string filter;
+	perf_counters counters;
+	std::vector<result> results;
+};
+
+// Tiers by footprint: malloc only, crossing into a mapping, and far past
+// the map threshold where mremap does the work.
+struct tier
+{
+	const char* name;
+	size_t bytes;
+	size_t repetitions;
+};
+
+constexpr tier tiers[] = {
+	{"small", 256, 4096},
+	{"medium", 64 << 10, 256},
+	{"large", 16 << 20, 3},
+};
+
+template<typename T>
+void operations(suite& s, const std::string& type)
+{
+	for(const tier& t : tiers)
+	{
+		size_t n = std::max<size_t>(t.bytes / sizeof(T), 4);
+		size_t reps = t.repetitions;
+		T value = make<T>(7);
+		auto empty = [] { return rvector<T>(); };
+		auto full = [n] { return filled<T>(n); };
+
+		s.run<T>("push_back", type, t.name, n, reps, empty,
+			[&](rvector<T>& v) {
+				for(size_t i = 0; i < n; ++i)
+					v.push_back(value);
+			});
+		size_t middle_ops = std::min<size_t>(n, 64);
+		s.run<T>("emplace", type, t.name, n, reps, full,
+			[&](rvector<T>& v) {
+				for(size_t i = 0; i < middle_ops; ++i)
+					v.emplace(v.begin() + v.size() / 2, value);
+			});
+		rvector<T> range = filled<T>(n / 4);
+		s.run<T>("insert", type, t.name, n, reps, full,
+			[&](rvector<T>& v) {
+				v.insert(v.begin() + v.size() / 2, range.begin(), range.end());
+			});
+		s.run<T>("erase", type, t.name, n, reps, full,
+			[&](rvector<T>& v) {
+				v.erase(v.begin() + n / 4, v.begin() + n / 2);
+			});
+		rvector<T> source = filled<T>(n);
+		std::vector<rvector<T>> copies;
+		copies.reserve(reps);
+		s.run<T>("copy", type, t.name, n, reps, [] { return 0; },
+			[&](int) { copies.emplace_back(source); });
+		copies.clear();
+		s.run<T>("assign", type, t.name, n, reps, empty,
+			[&](rvector<T>& v) { v.assign(source.begin(), source.end()); });
+		s.run<T>("resize", type, t.name, n, reps, empty,
+			[&](rvector<T>& v) { v.resize(n); });
+		s.run<T>("reserve", type, t.name, n, reps,
+			[n] { return filled<T>(n / 2); },
+			[&](rvector<T>& v) { v.reserve(n * 2); });
+	}
+}
+
+// Read side of snapshot_rvector: a snapshot against the plain load of
+// size(), alone and while a writer appends and grows the vector.
+void snapshots(suite& s)
+{
+	const size_t reps = 1 << 16;
+	const size_t reads = 64;
+	for(bool writing : {false, true})
+	{
+		const char* tier = writing ? "writer" : "idle";
+		snapshot_rvector<int> v;
+		for(int i = 0; i < 1024; ++i)
+			v.push_back(i);
+		std::atomic<bool> stop(false);
+		std::thread writer;
+		if(writing)
+			writer = std::thread([&] {
+				for(int i = 0; !stop.load(std::memory_order_relaxed) and 
+								i < (64 << 20); ++i)
+					v.push_back(i);
+			});
+		volatile size_t sink = 0;
+		s.run<int>("size", "int", tier, reads, reps, [] { return 0; },
+			[&](int) {
+				for(size_t i = 0; i < reads; ++i)
+					sink = sink + v.size();
+			});
+		s.run<int>("snapshot", "int", tier, reads, reps, [] { return 0; },
+			[&](int) {
+				for(size_t i = 0; i < reads; ++i)
+					sink = sink + v.snapshot().size();
+			});
+		stop = true;
+		if(writer.joinable())
+			writer.join();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	suite s(argc > 2 ? argv[2] : "");
+	snapshots(s);
+	operations<int>(s, "int");
+	operations<std::string>(s, "std::string");
+	operations<std::array<int, 10>>(s, "std::array<int,10>");
+	operations<TestType>(s, "TestType");
+	if(argc > 1)
+	{
+		std::ofstream out(argv[1]);
+		s.write(out);
+	}
+	else
+		s.write(std::cout);
+}
@@ -0,0 +1,402 @@
+#pragma once
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include "allocator.h"
+
+// Vector of trivially copyable records kept in a MAP_SHARED file mapping.
+// The file holds a one page header followed by the elements, so opening
+// an existing file maps the vector back without deserialization. Growth
+// extends the file with ftruncate and the mapping with mremap; the file
+// keeps its capacity when closed.
+template<typename T, typename Policy = mm::default_policy>
+class persistent_rvector
+{
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "persistent_rvector stores raw element bytes");
+public:
+	using value_type = T;
+	using size_type = size_t;
+
+	using reference = T&;
+	using const_reference = const T&;
+
+	using iterator = T*;
+	using const_iterator = const T*;
+
+    // Opens path, creating an empty vector if the file does not exist.
+    explicit persistent_rvector(const std::string& path);
+    persistent_rvector(persistent_rvector&& other) noexcept;
+    persistent_rvector(const persistent_rvector&) = delete;
+    persistent_rvector& operator =(persistent_rvector&& other) noexcept;
+    persistent_rvector& operator =(const persistent_rvector&) = delete;
+    ~persistent_rvector();
+
+	iterator begin() noexcept;
+	const_iterator begin() const noexcept;
+	iterator end() noexcept;
+    const_iterator end() const noexcept;
+
+    size_type size() const noexcept;
+    size_type capacity() const noexcept;
+    bool empty() const noexcept;
+    void resize(size_type sz, const T& c = T());
+    void reserve(size_type n);
+
+    reference operator[](size_type n);
+    const_reference operator[](size_type n) const;
+    reference at(size_type n);
+    const_reference at(size_type n) const;
+    reference back() noexcept;
+    const_reference back() const noexcept;
+
+    T* data() noexcept;
+    const T* data() const noexcept;
+
+    template <class... Args>
+    void emplace_back(Args&&... args);
+    void push_back(const T& x);
+    void pop_back() noexcept;
+    void clear() noexcept;
+
+    // Writes dirty pages back to the file.
+    void sync();
+private:
+    struct header
+    {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t element_size;
+        uint64_t length;
+    };
+
+    static constexpr uint64_t magic = 0x726f74636576726cull;
+    static constexpr uint32_t version = 1;
+
+    static size_type header_bytes() noexcept;
+    static size_type file_bytes(size_type n) noexcept;
+    [[noreturn]] static void fail(const char* what);
+
+    header* meta() const noexcept;
+    void change_capacity(size_type n);
+    void release() noexcept;
+
+    int fd_;
+    char* map_;
+    // Length of the mapping, which a file sized by other means may have
+    // beyond the pages its capacity needs.
+    size_type bytes_;
+    size_type capacity_;
+};
+
+template<typename T, typename Policy>
+typename persistent_rvector<T, Policy>::size_type
+persistent_rvector<T, Policy>::header_bytes() noexcept
+{
+    return mm::page_round<Policy>(sizeof(header));
+}
+
+// File size for at least n elements, rounded up to whole pages.
+template<typename T, typename Policy>
+typename persistent_rvector<T, Policy>::size_type
+persistent_rvector<T, Policy>::file_bytes(size_type n) noexcept
+{
+    return header_bytes() + mm::page_round<Policy>(n*sizeof(T));
+}
+
+template<typename T, typename Policy>
+void persistent_rvector<T, Policy>::fail(const char* what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+template<typename T, typename Policy>
+typename persistent_rvector<T, Policy>::header*
+persistent_rvector<T, Policy>::meta() const noexcept
+{
+    return (header*) map_;
+}
+
+template<typename T, typename Policy>
+persistent_rvector<T, Policy>::persistent_rvector(const std::string& path)
+ : fd_(open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)),
+ map_(nullptr),
+ bytes_(0),
+ capacity_(0)
+{
+    if(UNLIKELY(fd_ < 0))
+        fail("persistent_rvector: open");
+    struct stat st;
+    if(UNLIKELY(fstat(fd_, &st)))
+    {
+        close(fd_);
+        fail("persistent_rvector: fstat");
+    }
+    size_type bytes = st.st_size;
+    bool fresh = bytes == 0;
+    if(fresh)
+    {
+        bytes = file_bytes(1);
+        if(UNLIKELY(ftruncate(fd_, bytes)))
+        {
+            close(fd_);
+            fail("persistent_rvector: ftruncate");
+        }
+    }
+    if(UNLIKELY(bytes < header_bytes() or bytes % Policy::page_size()))
+    {
+        close(fd_);
+        throw std::runtime_error("persistent_rvector: truncated file " + path);
+    }
+    void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if(UNLIKELY(p == MAP_FAILED))
+    {
+        close(fd_);
+        fail("persistent_rvector: mmap");
+    }
+    map_ = (char*) p;
+    bytes_ = bytes;
+    capacity_ = (bytes - header_bytes()) / sizeof(T);
+    if(fresh)
+        *meta() = header{magic, version, sizeof(T), 0};
+    else if(UNLIKELY(meta()->magic != magic or
+                     meta()->version != version or
+                     meta()->element_size != sizeof(T) or
+                     meta()->length > capacity_))
+    {
+        munmap(map_, bytes);
+        close(fd_);
+        throw std::runtime_error("persistent_rvector: bad header in " + path);
+    }
+}
+
+template<typename T, typename Policy>
+persistent_rvector<T, Policy>::persistent_rvector(
+                                    persistent_rvector<T, Policy>&& other) noexcept
+ : fd_(other.fd_),
+ map_(other.map_),
+ bytes_(other.bytes_),
+ capacity_(other.capacity_)
+{
+    other.fd_ = -1;
+    other.map_ = nullptr;
+    other.bytes_ = 0;
+    other.capacity_ = 0;
+}
+
+// Closes the current file, then takes over other's.
+template<typename T, typename Policy>
+persistent_rvector<T, Policy>&
+persistent_rvector<T, Policy>::operator=(persistent_rvector<T, Policy>&& other) noexcept
+{
+    if(UNLIKELY(this == std::addressof(other))) return *this;
+    release();
+    std::swap(fd_, other.fd_);
+    std::swap(map_, other.map_);
+    std::swap(bytes_, other.bytes_);
+    std::swap(capacity_, other.capacity_);
+    return *this;
+}
+
+template<typename T, typename Policy>
+persistent_rvector<T, Policy>::~persistent_rvector()
+{
+    release();
+}
+
+template<typename T, typename Policy>
+void persistent_rvector<T, Policy>::release() noexcept
+{
+    if(map_)
+        munmap(map_, bytes_);
+    if(fd_ >= 0)
+        close(fd_);
+    fd_ = -1;
+    map_ = nullptr;
+    bytes_ = 0;
+    capacity_ = 0;
+}
+
+// Extends the file and then the mapping; mremap may move the mapping but
+// never copies the pages. If it fails, the longer file is still valid.
+template<typename T, typename Policy>
+void persistent_rvector<T, Policy>::change_capacity(size_type n)
+{
+    size_type new_bytes = file_bytes(n);
+    if(UNLIKELY(ftruncate(fd_, new_bytes)))
+        fail("persistent_rvector: ftruncate");
+    void* p = mm::remap_<T, Policy>((T*) map_, bytes_, new_bytes,
+                                    MREMAP_MAYMOVE);
+    if(UNLIKELY(p == MAP_FAILED))
+        fail("persistent_rvector: mremap");
+    mm::telemetry::add<T>(p == map_ ? mm::telemetry::inplace_remaps
+                                    : mm::telemetry::page_moves);
+    map_ = (char*) p;
+    bytes_ = new_bytes;
+    capacity_ = (new_bytes - header_bytes()) / sizeof(T);
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::iterator
+persistent_rvector<T, Policy>::begin() noexcept
+{
+    return data();
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::const_iterator
+persistent_rvector<T, Policy>::begin() const noexcept
+{
+    return data();
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::iterator
+persistent_rvector<T, Policy>::end() noexcept
+{
+    return data() + size();
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::const_iterator
+persistent_rvector<T, Policy>::end() const noexcept
+{
+    return data() + size();
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::size_type
+persistent_rvector<T, Policy>::size() const noexcept
+{
+    return meta()->length;
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::size_type
+persistent_rvector<T, Policy>::capacity() const noexcept
+{
+    return capacity_;
+}
+
+template <typename T, typename Policy>
+bool persistent_rvector<T, Policy>::empty() const noexcept
+{
+    return size() == 0;
+}
+
+template <typename T, typename Policy>
+void persistent_rvector<T, Policy>::resize(size_type size, const T& c)
+{
+    if(size > capacity_)
+        change_capacity(size);
+    if(size > meta()->length)
+        std::uninitialized_fill(end(), data() + size, c);
+    meta()->length = size;
+}
+
+template <typename T, typename Policy>
+void persistent_rvector<T, Policy>::reserve(size_type n)
+{
+    if(n <= capacity_) return;
+    change_capacity(std::max(n, Policy::template grow<T>(capacity_)));
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::reference
+persistent_rvector<T, Policy>::operator[](size_type n)
+{
+    return data()[n];
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::const_reference
+persistent_rvector<T, Policy>::operator[](size_type n) const
+{
+    return data()[n];
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::reference
+persistent_rvector<T, Policy>::at(size_type n)
+{
+    if(UNLIKELY(n >= size()))
+        throw std::out_of_range("Index out of range: " + std::to_string(n));
+    return data()[n];
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::const_reference
+persistent_rvector<T, Policy>::at(size_type n) const
+{
+    if(UNLIKELY(n >= size()))
+        throw std::out_of_range("Index out of range: " + std::to_string(n));
+    return data()[n];
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::reference
+persistent_rvector<T, Policy>::back() noexcept
+{
+    return data()[size() - 1];
+}
+
+template <typename T, typename Policy>
+typename persistent_rvector<T, Policy>::const_reference
+persistent_rvector<T, Policy>::back() const noexcept
+{
+    return data()[size() - 1];
+}
+
+template <typename T, typename Policy>
+T* persistent_rvector<T, Policy>::data() noexcept
+{
+    return (T*) (map_ + header_bytes());
+}
+
+template <typename T, typename Policy>
+const T* persistent_rvector<T, Policy>::data() const noexcept
+{
+    return (const T*) (map_ + header_bytes());
+}
+
+template <typename T, typename Policy>
+template <class... Args>
+void persistent_rvector<T, Policy>::emplace_back(Args&&... args)
+{
+    size_type length = size();
+    if(UNLIKELY(length == capacity_))
+        change_capacity(Policy::template grow<T>(capacity_));
+    new (data() + length) T(std::forward<Args>(args)...);
+    meta()->length = length + 1;
+}
+
+template <typename T, typename Policy>
+void persistent_rvector<T, Policy>::push_back(const T& x)
+{
+    emplace_back(x);
+}
+
+template <typename T, typename Policy>
+void persistent_rvector<T, Policy>::pop_back() noexcept
+{
+    --meta()->length;
+}
+
+template <typename T, typename Policy>
+void persistent_rvector<T, Policy>::clear() noexcept
+{
+    meta()->length = 0;
+}
+
+template <typename T, typename Policy>
+void persistent_rvector<T, Policy>::sync()
+{
+    if(UNLIKELY(msync(map_, file_bytes(size()), MS_SYNC)))
+        fail("persistent_rvector: msync");
+}
@@ -13,26 +13,32 @@
 #define LIKELY(x)       __builtin_expect((x),1)
 #define UNLIKELY(x)     __builtin_expect((x),0)
 
-template <class T> 
+template <class T, class Policy = mm::default_policy> 
 class rvector;
 
-template <class T>
-    bool operator==(const rvector<T>& x,const rvector<T>& y);
-template <class T>
-    bool operator< (const rvector<T>& x,const rvector<T>& y);
-template <class T>
-    bool operator!=(const rvector<T>& x,const rvector<T>& y);
-template <class T>
-    bool operator> (const rvector<T>& x,const rvector<T>& y);
-template <class T>
-    bool operator>=(const rvector<T>& x,const rvector<T>& y);
-template <class T>
-    bool operator<=(const rvector<T>& x,const rvector<T>& y);
-
-template <class T>
-    void swap(rvector<T>& x, rvector<T>& y);
+template <class T, class Policy>
+    bool operator==(const rvector<T, Policy>& x,const rvector<T, Policy>& y);
+template <class T, class Policy>
+    bool operator< (const rvector<T, Policy>& x,const rvector<T, Policy>& y);
+template <class T, class Policy>
+    bool operator!=(const rvector<T, Policy>& x,const rvector<T, Policy>& y);
+template <class T, class Policy>
+    bool operator> (const rvector<T, Policy>& x,const rvector<T, Policy>& y);
+template <class T, class Policy>
+    bool operator>=(const rvector<T, Policy>& x,const rvector<T, Policy>& y);
+template <class T, class Policy>
+    bool operator<=(const rvector<T, Policy>& x,const rvector<T, Policy>& y);
 
-template<typename T>
+template <class T, class Policy>
+    void swap(rvector<T, Policy>& x, rvector<T, Policy>& y);
+
+namespace mm
+{
+	template<typename T, typename Policy>
+	struct is_trivially_relocatable<rvector<T, Policy>> : std::true_type {};
+}
+
+template<typename T, typename Policy>
 class rvector
 {
 public:
@@ -49,14 +55,19 @@ public:
 	using const_reverse_iterator = const reverse_iterator;
 
 	rvector() noexcept;
+    explicit rvector(std::pmr::memory_resource* resource);
     explicit rvector(size_type count);
 	explicit rvector(size_type count, const T& value);
+    template<typename Executor, typename = mm::Executor<Executor>>
+    rvector(Executor& ex, size_type count, const T& value = T());
 
     template <class InputIterator, 
         typename = typename std::iterator_traits<InputIterator>::value_type>
     rvector (InputIterator first, InputIterator last);
 
 	rvector(const rvector& other);
+    template<typename Executor, typename = mm::Executor<Executor>>
+    rvector(Executor& ex, const rvector& other);
 	rvector(rvector&& other) noexcept;
 	rvector(std::initializer_list<T> ilist);
 
@@ -71,6 +82,12 @@ public:
         typename = typename std::iterator_traits<InputIt>::value_type>
 	void assign(InputIt first, InputIt last);
 	void assign(std::initializer_list<T> ilist);
+    template<typename Executor, typename = mm::Executor<Executor>>
+    void assign(Executor& ex, size_type count, const T& value);
+    template<typename Executor, typename InputIt, 
+        typename = mm::Executor<Executor>,
+        typename = typename std::iterator_traits<InputIt>::value_type>
+    void assign(Executor& ex, InputIt first, InputIt last);
 
 	iterator begin() noexcept;
 	const_iterator begin() const noexcept;
@@ -91,10 +108,16 @@ public:
     size_type size() const noexcept;
     size_type max_size() const noexcept;
     void resize(size_type sz);
+    T* resize_uninitialized(size_type sz);
+    T* append_uninitialized(size_type n);
     void resize(size_type sz, const T& c);
+    template<typename Executor, typename = mm::Executor<Executor>>
+    void resize(Executor& ex, size_type sz, const T& c = T());
     size_type capacity() const noexcept;
     bool empty() const noexcept;
     void reserve(size_type n);
+    void reserve(size_type n, mm::prefault mode, 
+                 std::chrono::nanoseconds budget = std::chrono::milliseconds(1));
     void shrink_to_fit();
  
  //    // element access:
@@ -110,6 +133,7 @@ public:
  //    //data access
     T* data() noexcept;
     const T* data() const noexcept;
+    std::vector<int> page_nodes() const;
  
  //    // modifiers:
     template <class... Args> 
@@ -135,80 +159,126 @@ public:
     iterator insert (iterator position, InputIterator first, 
                          InputIterator last);
     iterator insert(iterator position, std::initializer_list<T>);
+    void append(rvector&& other);
+    template <class... Rvectors>
+    void concat(Rvectors&&... others);
  
     iterator erase(iterator position);
     iterator erase(iterator first, iterator last);
-    void     swap(rvector<T>& other);
+    void     swap(rvector& other);
     void     clear() noexcept;
 private:
 	T* data_;
 	size_type length_;
     size_type capacity_;
 public:
-    constexpr static size_t map_threshold = 4096 / sizeof(T);
+    static size_type map_threshold() noexcept;
 };
 
-template<typename T>
-rvector<T>::rvector() noexcept
+template<typename T, typename Policy>
+rvector<T, Policy>::rvector() noexcept
  : data_(nullptr),
  length_(0),
  capacity_(0)
 {
 }
 
-template<typename T>
-rvector<T>::rvector(rvector<T>::size_type length)
+// Empty vector whose storage comes from resource, for policies with
+// uses_resource such as mm::pmr_policy.
+template<typename T, typename Policy>
+rvector<T, Policy>::rvector(std::pmr::memory_resource* resource)
+ : data_(nullptr),
+ length_(0),
+ capacity_(0)
+{
+    static_assert(Policy::uses_resource, 
+                  "the policy does not allocate from a memory resource");
+    data_ = mm::resource_allocate<T>(resource, 0);
+}
+
+template<typename T, typename Policy>
+rvector<T, Policy>::rvector(rvector<T, Policy>::size_type length)
  : data_(nullptr),
  length_(length),
- capacity_(mm::fix_capacity<T>(length_))
+ capacity_(mm::fix_capacity<T, Policy>(length_))
 {
-    data_ = mm::allocate<T>(capacity_);
-    mm::fill(data_, length_);
+    data_ = mm::allocate<T, Policy>(capacity_);
+    mm::value_fill<Policy>(data_, 0, length_, 0);
 }
 
-template<typename T>
-rvector<T>::rvector(typename rvector<T>::size_type length, const T& value)
+template<typename T, typename Policy>
+rvector<T, Policy>::rvector(typename rvector<T, Policy>::size_type length, const T& value)
  : data_(nullptr),
  length_(length),
- capacity_(mm::fix_capacity<T>(length_))
+ capacity_(mm::fix_capacity<T, Policy>(length_))
 {
-    data_ = mm::allocate<T>(capacity_);
-    mm::fill(data_, length_, value);
+    data_ = mm::allocate<T, Policy>(capacity_);
+    mm::fill<Policy>(data_, length_, value);
 }
 
 template <typename T>
 rvector(typename rvector<T>::size_type length, const T& v) -> rvector<T>;
 
-template <typename T>
+// Fills the elements in parallel on ex; see mm::parallel_init.
+template<typename T, typename Policy>
+template<typename Executor, typename>
+rvector<T, Policy>::rvector(Executor& ex, size_type length, const T& value)
+ : data_(nullptr),
+ length_(length),
+ capacity_(mm::fix_capacity<T, Policy>(length_))
+{
+    data_ = mm::allocate<T, Policy>(capacity_);
+    try
+    {
+        mm::parallel_fill<T, Policy>(ex, data_, length_, value);
+    }
+    catch(...)
+    {
+        mm::deallocate<T, Policy>(data_, capacity_);
+        throw;
+    }
+}
+
+template <typename T, typename Policy>
 template <class InputIterator, typename>
-rvector<T>::rvector(InputIterator first, InputIterator last)
+rvector<T, Policy>::rvector(InputIterator first, InputIterator last)
  : data_(nullptr),
  length_(std::distance(first, last)),
- capacity_(mm::fix_capacity<T>(length_))
+ capacity_(mm::fix_capacity<T, Policy>(length_))
 {
-    data_ = mm::allocate<T>(capacity_);
-    mm::fill(data_, first, last);
+    data_ = mm::allocate<T, Policy>(capacity_);
+    mm::fill<Policy>(data_, first, last);
 }
 
 template <class InputIterator, typename = typename std::iterator_traits<InputIterator>::value_type>
 rvector(InputIterator first, InputIterator last) -> 
     rvector<typename std::iterator_traits<InputIterator>::value_type>;
 
-template<typename T>
-rvector<T>::rvector(const rvector<T>& other)
+template<typename T, typename Policy>
+rvector<T, Policy>::rvector(const rvector<T, Policy>& other)
  : data_(nullptr),
  length_(other.length_),
  capacity_(other.capacity_)
 {
-    data_ = mm::allocate<T>(capacity_);
-    mm::fill(data_, other.begin(), other.end());
+    data_ = mm::clone<T, Policy>(other.data_, length_, capacity_);
 }
 
-template <typename T>
-rvector(const rvector<T>& other) -> rvector<T>;
+template <typename T, typename Policy>
+rvector(const rvector<T, Policy>& other) -> rvector<T, Policy>;
 
-template<typename T>
-rvector<T>::rvector(rvector<T>&& other) noexcept
+// Copies the elements in parallel on ex; see mm::parallel_init.
+template<typename T, typename Policy>
+template<typename Executor, typename>
+rvector<T, Policy>::rvector(Executor& ex, const rvector<T, Policy>& other)
+ : data_(nullptr),
+ length_(other.length_),
+ capacity_(other.capacity_)
+{
+    data_ = mm::clone<T, Policy>(ex, other.data_, length_, capacity_);
+}
+
+template<typename T, typename Policy>
+rvector<T, Policy>::rvector(rvector<T, Policy>&& other) noexcept
  : data_(other.data_),
  length_(other.length_),
  capacity_(other.capacity_)
@@ -218,129 +288,138 @@ rvector<T>::rvector(rvector<T>&& other) noexcept
     other.length_ = 0;
 }
 
-template <typename T>
-rvector(rvector<T>&& other) -> rvector<T>;
+template <typename T, typename Policy>
+rvector(rvector<T, Policy>&& other) -> rvector<T, Policy>;
 
-template<typename T>
-rvector<T>::rvector(std::initializer_list<T> ilist)
+template<typename T, typename Policy>
+rvector<T, Policy>::rvector(std::initializer_list<T> ilist)
  : data_(nullptr),
  length_(ilist.size()),
- capacity_(mm::fix_capacity<T>(ilist.size()))
+ capacity_(mm::fix_capacity<T, Policy>(ilist.size()))
 {
-    data_ = mm::allocate<T>(capacity_);
-    mm::fill(data_, ilist.begin(), ilist.end());
+    data_ = mm::allocate<T, Policy>(capacity_);
+    mm::fill<Policy>(data_, ilist.begin(), ilist.end());
 }
 
 template<typename T>
 rvector(std::initializer_list<T> ilist) -> rvector<T>;
 
-template<typename T>
-rvector<T>::~rvector()
+template<typename T, typename Policy>
+rvector<T, Policy>::~rvector()
 {
     mm::destruct(data_, data_ + length_);
-    mm::deallocate(data_, capacity_);
+    mm::deallocate<T, Policy>(data_, capacity_);
 }
 
-template <typename T>
-typename rvector<T>::iterator 
-rvector<T>::begin() noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::iterator 
+rvector<T, Policy>::begin() noexcept
 {
     return data_;
 }
 
-template <typename T>
-typename rvector<T>::const_iterator 
-rvector<T>::begin() const noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_iterator 
+rvector<T, Policy>::begin() const noexcept
 {
     return data_;
 }
 
-template <typename T>
-typename rvector<T>::iterator 
-rvector<T>::end() noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::iterator 
+rvector<T, Policy>::end() noexcept
 {
     return data_ + length_;
 }
 
-template <typename T>
-typename rvector<T>::const_iterator 
-rvector<T>::end() const noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_iterator 
+rvector<T, Policy>::end() const noexcept
 {
     return data_ + length_;
 }
 
-template <typename T>
-typename rvector<T>::reverse_iterator 
-rvector<T>::rbegin() noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::reverse_iterator 
+rvector<T, Policy>::rbegin() noexcept
 {
     return reverse_iterator(data_ + length_);
 }
 
-template <typename T>
-typename rvector<T>::const_reverse_iterator 
-rvector<T>::rbegin() const noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_reverse_iterator 
+rvector<T, Policy>::rbegin() const noexcept
 {
     return const_reverse_iterator(data_ + length_);
 }
 
-template <typename T>
-typename rvector<T>::reverse_iterator 
-rvector<T>::rend() noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::reverse_iterator 
+rvector<T, Policy>::rend() noexcept
 {
     return reverse_iterator(data_);
 }
 
-template <typename T>
-typename rvector<T>::const_reverse_iterator 
-rvector<T>::rend() const noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_reverse_iterator 
+rvector<T, Policy>::rend() const noexcept
 {
     return const_reverse_iterator(data_);
 }
 
-template <typename T>
-typename rvector<T>::const_iterator 
-rvector<T>::cbegin() noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_iterator 
+rvector<T, Policy>::cbegin() noexcept
 {
     return const_iterator(data_);
 }
 
-template <typename T>
-typename rvector<T>::const_iterator 
-rvector<T>::cend() noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_iterator 
+rvector<T, Policy>::cend() noexcept
 {
     return  const_iterator(data_ + length_);
 }
 
-template <typename T>
-typename rvector<T>::const_reverse_iterator 
-rvector<T>::crbegin() const noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_reverse_iterator 
+rvector<T, Policy>::crbegin() const noexcept
 {
     return const_reverse_iterator(data_ + length_);
 }
 
-template <typename T>
-typename rvector<T>::const_reverse_iterator 
-rvector<T>::crend() const noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_reverse_iterator 
+rvector<T, Policy>::crend() const noexcept
 {
     return const_reverse_iterator(data_);
 }
 
-template <typename T>
-rvector<T>& rvector<T>::operator=(const rvector<T>& other)
+template <typename T, typename Policy>
+rvector<T, Policy>& rvector<T, Policy>::operator=(const rvector<T, Policy>& other)
 {
     if(UNLIKELY(this == std::addressof(other))) return *this;
+    if constexpr(Policy::copy_on_write)
+        if(mm::is_mapped<T, Policy>(other.capacity_))
+        {
+            rvector copy(other);
+            swap(copy);
+            return *this;
+        }
     if(other.length_ > length_)
-        mm::change_capacity(data_, length_, capacity_, other.capacity_);
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, other.capacity_);
 
     mm::destruct(data_, data_ + length_);
-    mm::fill(data_, other.begin(), other.end());
+    length_ = 0;
+    mm::parallel_copy<T, Policy>(Policy::executor(), data_, other.data_, 
+                                 other.length_);
     length_ = other.length_;
 
     return *this;
 }
 
-template <typename T>
-rvector<T>& rvector<T>::operator=(rvector<T>&& other) noexcept
+template <typename T, typename Policy>
+rvector<T, Policy>& rvector<T, Policy>::operator=(rvector<T, Policy>&& other) noexcept
 {
     std::swap(data_, other.data_);
     std::swap(length_, other.length_);
@@ -349,313 +428,430 @@ rvector<T>& rvector<T>::operator=(rvector<T>&& other) noexcept
     return *this;
 }
    
-template <typename T>
-rvector<T>& rvector<T>::operator=(std::initializer_list<T> ilist)
+template <typename T, typename Policy>
+rvector<T, Policy>& rvector<T, Policy>::operator=(std::initializer_list<T> ilist)
 {
     if(ilist.size() > capacity_)
-        mm::change_capacity(data_, length_, capacity_, ilist.size());
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, ilist.size());
 
     mm::destruct(data_, data_ + length_);
-    mm::fill(data_, ilist.begin(), ilist.end());
+    mm::fill<Policy>(data_, ilist.begin(), ilist.end());
     length_ = ilist.size();
     return *this;
 } 
 
-template <typename T>
-void rvector<T>::assign(rvector<T>::size_type count, const T& value)
+template <typename T, typename Policy>
+void rvector<T, Policy>::assign(rvector<T, Policy>::size_type count, const T& value)
 {
     if(count > capacity_)
-        mm::change_capacity(data_, length_, capacity_, count);
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, count);
 
     mm::destruct(data_, data_ + length_);
-    mm::fill(data_, count, value);
+    mm::fill<Policy>(data_, count, value);
     length_ = count;
 }
-template <typename T>
+template <typename T, typename Policy>
+template <typename Executor, typename>
+void rvector<T, Policy>::assign(Executor& ex, size_type count, const T& value)
+{
+    if(count > capacity_)
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, count);
+
+    mm::destruct(data_, data_ + length_);
+    length_ = 0;
+    mm::parallel_fill<T, Policy>(ex, data_, count, value);
+    length_ = count;
+}
+
+template <typename T, typename Policy>
 template <typename InputIt, typename>
-void rvector<T>::assign(InputIt first, InputIt last)
+void rvector<T, Policy>::assign(InputIt first, InputIt last)
 {
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr(std::is_base_of_v<std::random_access_iterator_tag, category>)
+        return assign(Policy::executor(), first, last);
     size_t count = std::distance(first, last);
     if(count > capacity_)
-        mm::change_capacity(data_, length_, capacity_, count);
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, count);
 
     mm::destruct(data_, data_ + length_);
-    mm::fill(data_, first, last);
+    mm::fill<Policy>(data_, first, last);
     length_ = count;
 }
 
-template <typename T>
-void rvector<T>::assign(std::initializer_list<T> ilist)
+template <typename T, typename Policy>
+template <typename Executor, typename InputIt, typename, typename>
+void rvector<T, Policy>::assign(Executor& ex, InputIt first, InputIt last)
+{
+    size_t count = std::distance(first, last);
+    if(count > capacity_)
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, count);
+
+    mm::destruct(data_, data_ + length_);
+    length_ = 0;
+    mm::parallel_copy<T, Policy>(ex, data_, first, count);
+    length_ = count;
+}
+
+template <typename T, typename Policy>
+void rvector<T, Policy>::assign(std::initializer_list<T> ilist)
 {
     assign(ilist.begin(), ilist.end());
 }
 
-template <typename T>
-typename rvector<T>::size_type 
-rvector<T>::size() const noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::size_type 
+rvector<T, Policy>::size() const noexcept
 {
     return length_;
 }
 
-template <typename T>
-typename rvector<T>::size_type 
-rvector<T>::max_size() const noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::size_type 
+rvector<T, Policy>::max_size() const noexcept
 {
-    return std::numeric_limits<rvector<T>::size_type>::max() / sizeof(T);
+    return std::numeric_limits<size_type>::max() / sizeof(T);
 }
 
-template <typename T>
-void rvector<T>::resize(rvector<T>::size_type size)
+template <typename T, typename Policy>
+void rvector<T, Policy>::resize(rvector<T, Policy>::size_type size)
 {
+    size_type old_capacity = capacity_;
     if(size > capacity_)
-        mm::change_capacity(data_, length_, capacity_, size);        
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, size);        
     if(size < length_)
     { 
         mm::destruct(data_ + size, data_ + length_);
+        mm::trim<T, Policy>(data_, length_, size, capacity_);
         length_ = size;
     }
     else if(size > length_)
-        mm::fill(data_ + length_, size - length_);
+        mm::value_fill<Policy>(data_, length_, size, old_capacity);
     length_ = size;
 }
 
-template <typename T>
-void rvector<T>::resize(size_type size, const T& c)
+// Resizes without initializing the new elements, which the caller
+// overwrites, and returns the first of them.
+template <typename T, typename Policy>
+T* rvector<T, Policy>::resize_uninitialized(size_type size)
+{
+    static_assert(std::is_trivially_default_constructible<T>::value and
+                  std::is_trivially_destructible<T>::value,
+                  "uninitialized elements must be trivial");
+    if(size > capacity_)
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, size);
+    else if(size < length_)
+        mm::trim<T, Policy>(data_, length_, size, capacity_);
+    T* tail = data_ + std::min(length_, size);
+    length_ = size;
+    return tail;
+}
+
+// Appends n uninitialized elements, growing geometrically like push_back,
+// and returns the first of them.
+template <typename T, typename Policy>
+T* rvector<T, Policy>::append_uninitialized(size_type n)
+{
+    reserve(length_ + n);
+    return resize_uninitialized(length_ + n);
+}
+
+template <typename T, typename Policy>
+void rvector<T, Policy>::resize(size_type size, const T& c)
 {
     if(size > capacity_)
-        mm::change_capacity(data_, length_, capacity_, size);        
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, size);        
     if(size < length_)
     { 
         mm::destruct(data_ + size, data_ + length_);
+        mm::trim<T, Policy>(data_, length_, size, capacity_);
         length_ = size;
     }
     else if(size > length_)
-        mm::fill(data_ + length_, size - length_, c);
+        mm::fill<Policy>(data_ + length_, size - length_, c);
     length_ = size;
 }
 
-template <typename T>
-typename rvector<T>::size_type 
-rvector<T>::capacity() const noexcept
+template <typename T, typename Policy>
+template <typename Executor, typename>
+void rvector<T, Policy>::resize(Executor& ex, size_type size, const T& c)
+{
+    if(size <= length_)
+        return resize(size, c);
+    if(size > capacity_)
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, size);
+    mm::parallel_fill<T, Policy>(ex, data_ + length_, size - length_, c);
+    length_ = size;
+}
+
+template <typename T, typename Policy>
+typename rvector<T, Policy>::size_type 
+rvector<T, Policy>::capacity() const noexcept
 {
     return capacity_;
 }
 
 
-template <typename T>
-bool rvector<T>::empty() const noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::size_type 
+rvector<T, Policy>::map_threshold() noexcept
+{
+    return Policy::template map_threshold<T>();
+}
+
+template <typename T, typename Policy>
+bool rvector<T, Policy>::empty() const noexcept
 {
     return length_ == 0;
 }
 
-template <typename T>
-void rvector<T>::reserve(rvector<T>::size_type n)
+template <typename T, typename Policy>
+void rvector<T, Policy>::reserve(rvector<T, Policy>::size_type n)
 {
     if(n <= capacity_) return;
-    n = n < 2*capacity_? 2*capacity_: n;
-    mm::change_capacity(data_, length_, capacity_, n);
+    n = std::max(n, Policy::template grow<T>(capacity_));
+    mm::change_capacity<T, Policy>(data_, length_, capacity_, n);
 }
 
-template <typename T>
-void rvector<T>::shrink_to_fit()
+// Reserves as above and prefaults the pages past the length in the given mode.
+template <typename T, typename Policy>
+void rvector<T, Policy>::reserve(rvector<T, Policy>::size_type n, 
+                                 mm::prefault mode,
+                                 std::chrono::nanoseconds budget)
 {
-    if(capacity_ < map_threshold)
-        mm::change_capacity(data_, length_, capacity_, length_);
+    reserve(n);
+    if(mm::is_mapped<T, Policy>(capacity_))
+        mm::populate<Policy>(data_, length_*sizeof(T), capacity_*sizeof(T), 
+                             mode, budget);
 }
 
-template <typename T>
-typename rvector<T>::reference 
-rvector<T>::operator[](rvector<T>::size_type n)
+template <typename T, typename Policy>
+void rvector<T, Policy>::shrink_to_fit()
+{
+    mm::shrink<T, Policy>(data_, length_, capacity_);
+}
+
+template <typename T, typename Policy>
+typename rvector<T, Policy>::reference 
+rvector<T, Policy>::operator[](rvector<T, Policy>::size_type n)
 {
     return data_[n];
 }
 
-template <typename T>
-typename rvector<T>::const_reference 
-rvector<T>::operator[](rvector<T>::size_type n) const
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_reference 
+rvector<T, Policy>::operator[](rvector<T, Policy>::size_type n) const
 {
     return data_[n];
 }
 
-template <typename T>
-typename rvector<T>::reference 
-rvector<T>::at(rvector<T>::size_type n)
+template <typename T, typename Policy>
+typename rvector<T, Policy>::reference 
+rvector<T, Policy>::at(rvector<T, Policy>::size_type n)
 {
     if(UNLIKELY(n >= length_))
         throw std::out_of_range("Index out of range: " + std::to_string(n));
     return data_[n];
 }
 
-template <typename T>
-typename rvector<T>::const_reference 
-rvector<T>::at(rvector<T>::size_type n) const
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_reference 
+rvector<T, Policy>::at(rvector<T, Policy>::size_type n) const
 {
     if(UNLIKELY(n >= length_))
         throw std::out_of_range("Index out of range: " + std::to_string(n));
     return data_[n];
 }
 
-template <typename T>
-typename rvector<T>::reference 
-rvector<T>::front() noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::reference 
+rvector<T, Policy>::front() noexcept
 {
     return data_[0];
 }
 
-template <typename T>
-typename rvector<T>::const_reference 
-rvector<T>::front() const noexcept
+template <typename T, typename Policy>
+typename rvector<T, Policy>::const_reference 
+rvector<T, Policy>::front() const noexcept
 {
     return data_[0];
 }
 
-template <typename T>
+template <typename T, typename Policy>
 inline
-typename rvector<T>::reference 
-rvector<T>::back() noexcept
+typename rvector<T, Policy>::reference 
+rvector<T, Policy>::back() noexcept
 {
     return data_[length_ - 1];
 }
 
-template <typename T>
+template <typename T, typename Policy>
 inline
-typename rvector<T>::const_reference 
-rvector<T>::back() const noexcept
+typename rvector<T, Policy>::const_reference 
+rvector<T, Policy>::back() const noexcept
 {
     return data_[length_ - 1];
 }
 
-template <typename T>
-T* rvector<T>::data() noexcept
+template <typename T, typename Policy>
+T* rvector<T, Policy>::data() noexcept
 {
     return data_;
 }
 
-template <typename T>
-const T* rvector<T>::data() const noexcept
+template <typename T, typename Policy>
+const T* rvector<T, Policy>::data() const noexcept
 {
     return data_;
 }
 
-template <typename T>
+// NUMA node of each page holding the elements; see mm::page_nodes.
+template <typename T, typename Policy>
+std::vector<int> rvector<T, Policy>::page_nodes() const
+{
+    return mm::page_nodes<Policy>(data_, length_*sizeof(T));
+}
+
+template <typename T, typename Policy>
 template <class... Args> 
-void rvector<T>::emplace_back(Args&&... args)
+void rvector<T, Policy>::emplace_back(Args&&... args)
 {
-    mm::grow(data_, length_, capacity_);
+    mm::grow<T, Policy>(data_, length_, capacity_);
     new (data_ + length_) T(std::forward<Args>(args)...);
     ++length_;
 }
 
-template <typename T>
+template <typename T, typename Policy>
 template <class... Args> 
-void rvector<T>::fast_emplace_back(Args&&... args)
+void rvector<T, Policy>::fast_emplace_back(Args&&... args)
 {
     new (data_ + length_) T(std::forward<Args>(args)...);
     ++length_;
 }
 
-template <typename T>
-void rvector<T>::push_back(const T& x)
+template <typename T, typename Policy>
+void rvector<T, Policy>::push_back(const T& x)
 {
-    mm::grow(data_, length_, capacity_);
+    mm::grow<T, Policy>(data_, length_, capacity_);
     new (data_ + length_) T(x);
     ++length_;
 }
 
-template <typename T>
-void rvector<T>::fast_push_back(const T& x)
+template <typename T, typename Policy>
+void rvector<T, Policy>::fast_push_back(const T& x)
 {
     new (data_ + length_) T(x);
     ++length_;
 }
 
-template <typename T>
-void rvector<T>::push_back(T&& x)
+template <typename T, typename Policy>
+void rvector<T, Policy>::push_back(T&& x)
 {
-    mm::grow(data_, length_, capacity_);
+    mm::grow<T, Policy>(data_, length_, capacity_);
     new (data_ + length_) T(std::forward<T>(x));
     ++length_;
 }
 
-template <typename T>
-void rvector<T>::fast_push_back(T&& x)
+template <typename T, typename Policy>
+void rvector<T, Policy>::fast_push_back(T&& x)
 {
     new (data_ + length_) T(std::forward<T>(x));
     ++length_;
 }
 
-template <typename T>
-void rvector<T>::pop_back() noexcept
+template <typename T, typename Policy>
+void rvector<T, Policy>::pop_back() noexcept
 {
     if constexpr(!std::is_trivially_destructible_v<T>)
         back().~T();
     --length_;
+    mm::trim<T, Policy>(data_, length_ + 1, length_, capacity_);
 }
 
-template <typename T>
-void rvector<T>::safe_pop_back() noexcept
+template <typename T, typename Policy>
+void rvector<T, Policy>::safe_pop_back() noexcept
 {
     if(length_ == 0) return;
     if constexpr(!std::is_trivially_destructible_v<T>)
         back().~T();
     --length_;
+    mm::trim<T, Policy>(data_, length_ + 1, length_, capacity_);
 }
 
-template <typename T>
+template <typename T, typename Policy>
 template <class... Args> 
-typename rvector<T>::iterator 
-rvector<T>::emplace(rvector<T>::const_iterator position, 
+typename rvector<T, Policy>::iterator 
+rvector<T, Policy>::emplace(rvector<T, Policy>::const_iterator position, 
                     Args&&... args)
 {
     auto m = std::distance(cbegin(), position);
-    mm::grow(data_, length_, capacity_);
+    if(UNLIKELY(length_ == capacity_))
+    {
+        T* gap = mm::grow_gap<T, Policy>(data_, length_, capacity_, m, 1);
+        new (gap) T(std::forward<Args>(args)...);
+        ++length_;
+        return gap;
+    }
     iterator position_ = begin() + m;
-    mm::shiftr_data(position_, (end() - position_));
+    mm::shiftr_data<Policy>(position_, (end() - position_));
     new (position_) T(std::forward<Args>(args)...);
     ++length_;
     return position_;
 }
 
-template <typename T>
-typename rvector<T>::iterator 
-rvector<T>::insert(rvector<T>::iterator position, const T& x)
+template <typename T, typename Policy>
+typename rvector<T, Policy>::iterator 
+rvector<T, Policy>::insert(rvector<T, Policy>::iterator position, const T& x)
 {
     auto m = std::distance(begin(), position);
-    mm::grow(data_, length_, capacity_);
-    position = begin() + m;
-    mm::shiftr_data(position, (end() - position));
+    if(UNLIKELY(length_ == capacity_))
+    {
+        T* gap = mm::grow_gap<T, Policy>(data_, length_, capacity_, m, 1);
+        new (gap) T(x);
+        ++length_;
+        return gap;
+    }
+    mm::shiftr_data<Policy>(position, (end() - position));
     new (position) T(x);
     ++length_;
     return position;
 }
 
-template <typename T>
-typename rvector<T>::iterator 
-rvector<T>::insert(rvector<T>::iterator position, T&& x)
+template <typename T, typename Policy>
+typename rvector<T, Policy>::iterator 
+rvector<T, Policy>::insert(rvector<T, Policy>::iterator position, T&& x)
 {
     auto m = std::distance(begin(), position);
-    mm::grow(data_, length_, capacity_);
-    position = begin() + m;
-    mm::shiftr_data(position, (end() - position));
+    if(UNLIKELY(length_ == capacity_))
+    {
+        T* gap = mm::grow_gap<T, Policy>(data_, length_, capacity_, m, 1);
+        new (gap) T(std::forward<T>(x));
+        ++length_;
+        return gap;
+    }
+    mm::shiftr_data<Policy>(position, (end() - position));
     new (position) T(std::forward<T>(x));
     ++length_;
     return position;
 }
-// TODO: add realloc optimalization for insert
-template <typename T>
-typename rvector<T>::iterator 
-rvector<T>::insert(rvector<T>::iterator position, size_type n, const T& x)
+template <typename T, typename Policy>
+typename rvector<T, Policy>::iterator 
+rvector<T, Policy>::insert(rvector<T, Policy>::iterator position, size_type n, const T& x)
 {
     if(length_ + n > capacity_)
     {
-        auto m = std::distance(begin(), position);
-        size_type new_cap = std::max(length_ + n, capacity_ * 2);
-        mm::change_capacity(data_, length_, capacity_, new_cap);
-        position = begin() + m;
+        T* gap = mm::grow_gap<T, Policy>(data_, length_, capacity_, 
+                                         position - data_, n);
+        std::uninitialized_fill(gap, gap + n, x);
+        length_ += n;
+        return gap;
     }
     auto end_ = end();
     size_type rest = std::distance(position, end_);
-    if(rest > n) {
+    if(mm::remap_shiftable<T, Policy>(capacity_, n, rest)) {
+        mm::shift_tail<T, Policy>(data_, position - data_, length_, n);
+        std::uninitialized_fill(position, position + n, x);
+    } else if(rest > n) {
         std::uninitialized_move(end_ - n, end_, end_);
         std::move_backward(position, end_ - n, end_);
         std::fill(position, position + n, x);
@@ -668,23 +864,27 @@ rvector<T>::insert(rvector<T>::iterator position, size_type n, const T& x)
     return position;
 }
 
-template <typename T>
+template <typename T, typename Policy>
 template <class InputIterator, typename>
-typename rvector<T>::iterator 
-rvector<T>::insert (rvector<T>::iterator position, InputIterator first, 
+typename rvector<T, Policy>::iterator 
+rvector<T, Policy>::insert (rvector<T, Policy>::iterator position, InputIterator first, 
                      InputIterator last)
 {
     size_type n = std::distance(first, last);
     if(length_ + n > capacity_)
     {
-        auto m = std::distance(begin(), position);
-        size_type new_cap = std::max(length_ + n, capacity_ * 2);
-        mm::change_capacity(data_, length_, capacity_, new_cap);
-        position = begin() + m;
+        T* gap = mm::grow_gap<T, Policy>(data_, length_, capacity_, 
+                                         position - data_, n);
+        std::uninitialized_copy(first, last, gap);
+        length_ += n;
+        return gap;
     }
     auto end_ = end();
     size_type rest = std::distance(position, end_);
-    if(rest > n) {
+    if(mm::remap_shiftable<T, Policy>(capacity_, n, rest)) {
+        mm::shift_tail<T, Policy>(data_, position - data_, length_, n);
+        std::uninitialized_copy(first, last, position);
+    } else if(rest > n) {
         std::uninitialized_move(end_ - n, end_, end_);
         std::move_backward(position, end_ - n, end_);
         std::copy(first, last, position);
@@ -697,19 +897,20 @@ rvector<T>::insert (rvector<T>::iterator position, InputIterator first,
     return position;    
 }
 
-template <typename T>
-typename rvector<T>::iterator 
-rvector<T>::insert(rvector<T>::iterator position, std::initializer_list<T> ilist)
+template <typename T, typename Policy>
+typename rvector<T, Policy>::iterator 
+rvector<T, Policy>::insert(rvector<T, Policy>::iterator position, std::initializer_list<T> ilist)
 {
     auto first = ilist.begin();
     auto last = ilist.end();
     size_type n = std::distance(first, last);
     if(length_ + n > capacity_)
     {
-        auto m = std::distance(begin(), position);
-        size_type new_cap = std::max(length_ + n, capacity_ * 2);
-        mm::change_capacity(data_, length_, capacity_, new_cap);
-        position = begin() + m;  
+        T* gap = mm::grow_gap<T, Policy>(data_, length_, capacity_, 
+                                         position - data_, n);
+        std::uninitialized_copy(first, last, gap);
+        length_ += n;
+        return gap;
     }
     auto end_ = end();
     size_type rest = std::distance(position, end_);
@@ -726,30 +927,77 @@ rvector<T>::insert(rvector<T>::iterator position, std::initializer_list<T> ilist
     return position; 
 }
 
-template <typename T>
-typename rvector<T>::iterator 
-rvector<T>::erase(rvector<T>::iterator position)
+// Moves the elements of other to the end, leaving it empty. Mapped sources
+// hand over their pages when the current elements end on a page boundary;
+// otherwise the elements are moved one by one, since each stolen page has
+// to keep its offset. A block with stolen pages spans several mappings and
+// is copied into one on its next growth.
+template <typename T, typename Policy>
+void rvector<T, Policy>::append(rvector<T, Policy>&& other)
+{
+    if(UNLIKELY(this == std::addressof(other)) or other.length_ == 0) return;
+    if(length_ == 0 and capacity_ <= other.capacity_)
+    {
+        swap(other);
+        return;
+    }
+    if(mm::steal_pages<T, Policy>(data_, length_, capacity_, 
+                            other.data_, other.length_, other.capacity_))
+    {
+        length_ += other.length_;
+        other.data_ = nullptr;
+        other.length_ = 0;
+        other.capacity_ = 0;
+        return;
+    }
+    insert(end(), std::make_move_iterator(other.begin()), 
+           std::make_move_iterator(other.end()));
+    other.clear();
+}
+
+// Appends each of others in turn. Only shards that start on a page
+// boundary of the result hand over their pages, so zero-copy concatenation
+// needs every shard but the last to hold a whole number of pages.
+template <typename T, typename Policy>
+template <class... Rvectors>
+void rvector<T, Policy>::concat(Rvectors&&... others)
+{
+    static_assert((std::is_same_v<Rvectors, rvector> and ...), 
+                  "concat takes rvector rvalues");
+    reserve(length_ + (others.size() + ... + 0));
+    (append(std::move(others)), ...);
+}
+
+template <typename T, typename Policy>
+typename rvector<T, Policy>::iterator 
+rvector<T, Policy>::erase(rvector<T, Policy>::iterator position)
 {
     if (position + 1 != end())
-        std::copy(position + 1, end(), position);
+        std::move(position + 1, end(), position);
     pop_back();
     return position;
 }
 
-template <typename T>
-typename rvector<T>::iterator 
-rvector<T>::erase(rvector<T>::iterator first, rvector<T>::iterator last)
+template <typename T, typename Policy>
+typename rvector<T, Policy>::iterator 
+rvector<T, Policy>::erase(rvector<T, Policy>::iterator first, rvector<T, Policy>::iterator last)
 {
     auto n = std::distance(first, last);
-    if (last != end())
-        std::move(last, end(), first);
-    mm::destruct(end() - n, end());
+    if(mm::remap_shiftable<T, Policy>(capacity_, n, end() - last)) {
+        mm::destruct(first, last);
+        mm::shift_tail<T, Policy>(data_, last - data_, length_, -n);
+    } else {
+        if (last != end())
+            std::move(last, end(), first);
+        mm::destruct(end() - n, end());
+    }
     length_ -= n;
+    mm::trim<T, Policy>(data_, length_ + n, length_, capacity_);
     return first;
 }
 
-template <typename T>
-void rvector<T>::swap(rvector<T>& other)
+template <typename T, typename Policy>
+void rvector<T, Policy>::swap(rvector<T, Policy>& other)
 {
     using std::swap;
     swap(data_, other.data_);
@@ -757,54 +1005,55 @@ void rvector<T>::swap(rvector<T>& other)
     swap(capacity_, other.capacity_);
 }
 
-template <typename T>
-void rvector<T>::clear() noexcept
+template <typename T, typename Policy>
+void rvector<T, Policy>::clear() noexcept
 {
     mm::destruct(data_, data_ + length_);
+    mm::trim<T, Policy>(data_, length_, 0, capacity_);
     length_ = 0;
 }
 
 
-template <class T>
-bool operator==(const rvector<T>& x, const rvector<T>& y)
+template <class T, class Policy>
+bool operator==(const rvector<T, Policy>& x, const rvector<T, Policy>& y)
 {
     if(x.size() != y.size()) return false;
     return std::equal(x.begin(), x.end(), y.begin());
 }
 
-template <class T>
-bool operator< (const rvector<T>& x,const rvector<T>& y)
+template <class T, class Policy>
+bool operator< (const rvector<T, Policy>& x, const rvector<T, Policy>& y)
 {
     return std::lexicographical_compare(x.begin(), x.end(), 
                                         y.begin(), y.end());
 }
 
-template <class T>
-bool operator!=(const rvector<T>& x,const rvector<T>& y)
+template <class T, class Policy>
+bool operator!=(const rvector<T, Policy>& x, const rvector<T, Policy>& y)
 {
     return !(x == y);
 }
 
-template <class T>
-bool operator> (const rvector<T>& x,const rvector<T>& y)
+template <class T, class Policy>
+bool operator> (const rvector<T, Policy>& x, const rvector<T, Policy>& y)
 {
     return y < x;
 }
 
-template <class T>
-bool operator>=(const rvector<T>& x,const rvector<T>& y)
+template <class T, class Policy>
+bool operator>=(const rvector<T, Policy>& x, const rvector<T, Policy>& y)
 {
     return !(x < y);
 }
 
-template <class T>
-bool operator<=(const rvector<T>& x,const rvector<T>& y)
+template <class T, class Policy>
+bool operator<=(const rvector<T, Policy>& x, const rvector<T, Policy>& y)
 {
     return !(y < x);
 }
 
-template <class T>
-void swap(rvector<T>& x, rvector<T>& y)
+template <class T, class Policy>
+void swap(rvector<T, Policy>& x, rvector<T, Policy>& y)
 {
     x.swap(y);
 }
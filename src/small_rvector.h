@@ -0,0 +1,1069 @@
+#pragma once
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <limits>
+#include "allocator.h"
+
+// Vector that keeps up to N elements inline and, once it outgrows them,
+// moves to the same malloc/mmap/mremap storage as rvector. Spilled storage
+// only returns inline through shrink_to_fit.
+template <class T, size_t N, class Policy = mm::default_policy>
+class small_rvector;
+
+template <class T, size_t N, class Policy>
+    bool operator==(const small_rvector<T, N, Policy>& x,
+                    const small_rvector<T, N, Policy>& y);
+template <class T, size_t N, class Policy>
+    bool operator< (const small_rvector<T, N, Policy>& x,
+                    const small_rvector<T, N, Policy>& y);
+template <class T, size_t N, class Policy>
+    bool operator!=(const small_rvector<T, N, Policy>& x,
+                    const small_rvector<T, N, Policy>& y);
+template <class T, size_t N, class Policy>
+    bool operator> (const small_rvector<T, N, Policy>& x,
+                    const small_rvector<T, N, Policy>& y);
+template <class T, size_t N, class Policy>
+    bool operator>=(const small_rvector<T, N, Policy>& x,
+                    const small_rvector<T, N, Policy>& y);
+template <class T, size_t N, class Policy>
+    bool operator<=(const small_rvector<T, N, Policy>& x,
+                    const small_rvector<T, N, Policy>& y);
+
+template <class T, size_t N, class Policy>
+    void swap(small_rvector<T, N, Policy>& x, small_rvector<T, N, Policy>& y);
+
+template<typename T, size_t N, typename Policy>
+class small_rvector
+{
+    static_assert(N > 0, "small_rvector needs room for one inline element");
+public:
+	using value_type = T;
+	using size_type = size_t;
+
+	using reference = T&;
+	using const_reference = const T&;
+
+	using iterator = T*;
+	using const_iterator = const T*;
+
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	small_rvector() noexcept;
+    explicit small_rvector(size_type count);
+	explicit small_rvector(size_type count, const T& value);
+    template<typename Executor, typename = mm::Executor<Executor>>
+    small_rvector(Executor& ex, size_type count, const T& value = T());
+
+    template <class InputIterator,
+        typename = typename std::iterator_traits<InputIterator>::value_type>
+    small_rvector(InputIterator first, InputIterator last);
+
+	small_rvector(const small_rvector& other);
+    template<typename Executor, typename = mm::Executor<Executor>>
+    small_rvector(Executor& ex, const small_rvector& other);
+	small_rvector(small_rvector&& other)
+        noexcept(std::is_nothrow_move_constructible_v<T>);
+	small_rvector(std::initializer_list<T> ilist);
+
+	~small_rvector();
+
+	small_rvector& operator =(const small_rvector& other);
+	small_rvector& operator =(small_rvector&& other)
+        noexcept(std::is_nothrow_move_constructible_v<T>);
+	small_rvector& operator =(std::initializer_list<T> ilist);
+
+	void assign(size_type count, const T& value);
+	template<typename InputIt,
+        typename = typename std::iterator_traits<InputIt>::value_type>
+	void assign(InputIt first, InputIt last);
+	void assign(std::initializer_list<T> ilist);
+    template<typename Executor, typename = mm::Executor<Executor>>
+    void assign(Executor& ex, size_type count, const T& value);
+    template<typename Executor, typename InputIt,
+        typename = mm::Executor<Executor>,
+        typename = typename std::iterator_traits<InputIt>::value_type>
+    void assign(Executor& ex, InputIt first, InputIt last);
+
+	iterator begin() noexcept;
+	const_iterator begin() const noexcept;
+	iterator end() noexcept;
+    const_iterator end() const noexcept;
+
+	reverse_iterator rbegin() noexcept;
+    const_reverse_iterator rbegin() const noexcept;
+    reverse_iterator rend() noexcept;
+    const_reverse_iterator rend() const noexcept;
+
+    const_iterator cbegin() const noexcept;
+    const_iterator cend() const noexcept;
+    const_reverse_iterator crbegin() const noexcept;
+    const_reverse_iterator crend() const noexcept;
+
+ //    // capacity:
+    size_type size() const noexcept;
+    size_type max_size() const noexcept;
+    void resize(size_type sz);
+    T* resize_uninitialized(size_type sz);
+    T* append_uninitialized(size_type n);
+    void resize(size_type sz, const T& c);
+    template<typename Executor, typename = mm::Executor<Executor>>
+    void resize(Executor& ex, size_type sz, const T& c = T());
+    size_type capacity() const noexcept;
+    bool empty() const noexcept;
+    bool is_inline() const noexcept;
+    void reserve(size_type n);
+    void reserve(size_type n, mm::prefault mode,
+                 std::chrono::nanoseconds budget = std::chrono::milliseconds(1));
+    void shrink_to_fit();
+
+ //    // element access:
+    reference operator[](size_type n);
+    const_reference operator[](size_type n) const;
+    reference at(size_type n);
+    const_reference at(size_type n) const;
+    reference front() noexcept;
+    const_reference front() const noexcept;
+    reference back() noexcept;
+    const_reference back() const noexcept;
+
+ //    //data access
+    T* data() noexcept;
+    const T* data() const noexcept;
+    std::vector<int> page_nodes() const;
+
+ //    // modifiers:
+    template <class... Args>
+    void emplace_back(Args&&... args);
+    template <class... Args>
+    void fast_emplace_back(Args&&... args);
+
+    void push_back(const T& x);
+    void fast_push_back(const T& x);
+    void push_back(T&& x);
+    void fast_push_back(T&& x);
+
+    void pop_back() noexcept;
+    void safe_pop_back() noexcept;
+
+    template <class... Args>
+    iterator emplace(const_iterator position, Args&&... args);
+    iterator insert(iterator position, const T& x);
+    iterator insert(iterator position, T&& x);
+    iterator insert(iterator position, size_type n, const T& x);
+    template <class InputIterator,
+        typename = typename std::iterator_traits<InputIterator>::value_type>
+    iterator insert (iterator position, InputIterator first,
+                         InputIterator last);
+    iterator insert(iterator position, std::initializer_list<T>);
+
+    iterator erase(iterator position);
+    iterator erase(iterator first, iterator last);
+    void append(small_rvector&& other);
+    template <class... SmallRvectors>
+    void concat(SmallRvectors&&... others);
+    void     swap(small_rvector& other);
+    void     clear() noexcept;
+
+    static size_type map_threshold() noexcept;
+private:
+    T* inline_data() noexcept;
+    void change_capacity(size_type n);
+    T* grow_gap(size_type position, size_type n);
+    void grow();
+    void make_room(size_type n);
+    void steal(small_rvector& other)
+        noexcept(std::is_nothrow_move_constructible_v<T>);
+    void release_heap() noexcept;
+
+	T* data_;
+	size_type length_;
+    size_type capacity_;
+    alignas(T) unsigned char buffer_[N * sizeof(T)];
+};
+
+template<typename T, size_t N, typename Policy>
+T* small_rvector<T, N, Policy>::inline_data() noexcept
+{
+    return reinterpret_cast<T*>(buffer_);
+}
+
+template<typename T, size_t N, typename Policy>
+bool small_rvector<T, N, Policy>::is_inline() const noexcept
+{
+    return data_ == reinterpret_cast<const T*>(buffer_);
+}
+
+// Grows the capacity to at least n, spilling the inline elements into
+// storage from mm::allocate on the first call.
+template<typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::change_capacity(size_type n)
+{
+    if(!is_inline())
+    {
+        mm::change_capacity<T, Policy>(data_, length_, capacity_, n);
+        return;
+    }
+    size_type new_capacity = mm::fix_capacity<T, Policy>(n);
+    T* new_data = mm::allocate<T, Policy>(new_capacity);
+    try
+    {
+        std::uninitialized_move_n(data_, length_, new_data);
+    }
+    catch(...)
+    {
+        mm::deallocate<T, Policy>(new_data, new_capacity);
+        throw;
+    }
+    mm::destruct(data_, data_ + length_);
+    data_ = new_data;
+    capacity_ = new_capacity;
+}
+
+// Grows for n more elements and opens an uninitialized gap of n elements
+// at position, moving every element once; see mm::grow_gap. Returns the
+// gap.
+template<typename T, size_t N, typename Policy>
+T* small_rvector<T, N, Policy>::grow_gap(size_type position, size_type n)
+{
+    if(!is_inline())
+        return mm::grow_gap<T, Policy>(data_, length_, capacity_, position, n);
+    size_type new_capacity = mm::fix_capacity<T, Policy>(
+        std::max(length_ + n, Policy::template grow<T>(capacity_)));
+    T* new_data = mm::allocate<T, Policy>(new_capacity);
+    try
+    {
+        std::uninitialized_move_n(data_, position, new_data);
+        try
+        {
+            std::uninitialized_move_n(data_ + position, length_ - position,
+                                      new_data + position + n);
+        }
+        catch(...)
+        {
+            mm::destruct(new_data, new_data + position);
+            throw;
+        }
+    }
+    catch(...)
+    {
+        mm::deallocate<T, Policy>(new_data, new_capacity);
+        throw;
+    }
+    mm::destruct(data_, data_ + length_);
+    data_ = new_data;
+    capacity_ = new_capacity;
+    return data_ + position;
+}
+
+template<typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::grow()
+{
+    if(LIKELY(length_ < capacity_)) return;
+    change_capacity(Policy::template grow<T>(capacity_));
+}
+
+// Makes room for n more elements.
+template<typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::make_room(size_type n)
+{
+    if(length_ + n <= capacity_) return;
+    change_capacity(std::max(length_ + n, Policy::template grow<T>(capacity_)));
+}
+
+// Takes over other's elements, leaving it empty and inline. The caller
+// has released its own elements and heap storage.
+template<typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::steal(small_rvector<T, N, Policy>& other)
+    noexcept(std::is_nothrow_move_constructible_v<T>)
+{
+    if(other.is_inline())
+    {
+        data_ = inline_data();
+        capacity_ = N;
+        std::uninitialized_move_n(other.data_, other.length_, data_);
+        length_ = other.length_;
+        other.clear();
+        return;
+    }
+    data_ = other.data_;
+    length_ = other.length_;
+    capacity_ = other.capacity_;
+    other.data_ = other.inline_data();
+    other.length_ = 0;
+    other.capacity_ = N;
+}
+
+template<typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::release_heap() noexcept
+{
+    if(!is_inline())
+        mm::deallocate<T, Policy>(data_, capacity_);
+    data_ = inline_data();
+    capacity_ = N;
+}
+
+template<typename T, size_t N, typename Policy>
+small_rvector<T, N, Policy>::small_rvector() noexcept
+ : data_(inline_data()),
+ length_(0),
+ capacity_(N)
+{
+}
+
+template<typename T, size_t N, typename Policy>
+small_rvector<T, N, Policy>::small_rvector(size_type length)
+ : small_rvector()
+{
+    resize(length);
+}
+
+template<typename T, size_t N, typename Policy>
+small_rvector<T, N, Policy>::small_rvector(size_type length, const T& value)
+ : small_rvector()
+{
+    resize(length, value);
+}
+
+// Fills the elements in parallel on ex once they spill; see
+// mm::parallel_init.
+template<typename T, size_t N, typename Policy>
+template<typename Executor, typename>
+small_rvector<T, N, Policy>::small_rvector(Executor& ex, size_type length,
+                                           const T& value)
+ : small_rvector()
+{
+    resize(ex, length, value);
+}
+
+template <typename T, size_t N, typename Policy>
+template <class InputIterator, typename>
+small_rvector<T, N, Policy>::small_rvector(InputIterator first, InputIterator last)
+ : small_rvector()
+{
+    assign(first, last);
+}
+
+template<typename T, size_t N, typename Policy>
+small_rvector<T, N, Policy>::small_rvector(const small_rvector<T, N, Policy>& other)
+ : small_rvector()
+{
+    assign(other.begin(), other.end());
+}
+
+template<typename T, size_t N, typename Policy>
+template<typename Executor, typename>
+small_rvector<T, N, Policy>::small_rvector(Executor& ex,
+                                           const small_rvector<T, N, Policy>& other)
+ : small_rvector()
+{
+    assign(ex, other.begin(), other.end());
+}
+
+template<typename T, size_t N, typename Policy>
+small_rvector<T, N, Policy>::small_rvector(small_rvector<T, N, Policy>&& other)
+    noexcept(std::is_nothrow_move_constructible_v<T>)
+{
+    steal(other);
+}
+
+template<typename T, size_t N, typename Policy>
+small_rvector<T, N, Policy>::small_rvector(std::initializer_list<T> ilist)
+ : small_rvector()
+{
+    assign(ilist.begin(), ilist.end());
+}
+
+template<typename T, size_t N, typename Policy>
+small_rvector<T, N, Policy>::~small_rvector()
+{
+    mm::destruct(data_, data_ + length_);
+    release_heap();
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::iterator
+small_rvector<T, N, Policy>::begin() noexcept
+{
+    return data_;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_iterator
+small_rvector<T, N, Policy>::begin() const noexcept
+{
+    return data_;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::iterator
+small_rvector<T, N, Policy>::end() noexcept
+{
+    return data_ + length_;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_iterator
+small_rvector<T, N, Policy>::end() const noexcept
+{
+    return data_ + length_;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::reverse_iterator
+small_rvector<T, N, Policy>::rbegin() noexcept
+{
+    return reverse_iterator(end());
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_reverse_iterator
+small_rvector<T, N, Policy>::rbegin() const noexcept
+{
+    return const_reverse_iterator(end());
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::reverse_iterator
+small_rvector<T, N, Policy>::rend() noexcept
+{
+    return reverse_iterator(begin());
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_reverse_iterator
+small_rvector<T, N, Policy>::rend() const noexcept
+{
+    return const_reverse_iterator(begin());
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_iterator
+small_rvector<T, N, Policy>::cbegin() const noexcept
+{
+    return begin();
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_iterator
+small_rvector<T, N, Policy>::cend() const noexcept
+{
+    return end();
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_reverse_iterator
+small_rvector<T, N, Policy>::crbegin() const noexcept
+{
+    return rbegin();
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_reverse_iterator
+small_rvector<T, N, Policy>::crend() const noexcept
+{
+    return rend();
+}
+
+template <typename T, size_t N, typename Policy>
+small_rvector<T, N, Policy>&
+small_rvector<T, N, Policy>::operator=(const small_rvector<T, N, Policy>& other)
+{
+    if(UNLIKELY(this == std::addressof(other))) return *this;
+    assign(other.begin(), other.end());
+    return *this;
+}
+
+template <typename T, size_t N, typename Policy>
+small_rvector<T, N, Policy>&
+small_rvector<T, N, Policy>::operator=(small_rvector<T, N, Policy>&& other)
+    noexcept(std::is_nothrow_move_constructible_v<T>)
+{
+    if(UNLIKELY(this == std::addressof(other))) return *this;
+    clear();
+    release_heap();
+    steal(other);
+    return *this;
+}
+
+template <typename T, size_t N, typename Policy>
+small_rvector<T, N, Policy>&
+small_rvector<T, N, Policy>::operator=(std::initializer_list<T> ilist)
+{
+    assign(ilist.begin(), ilist.end());
+    return *this;
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::assign(size_type count, const T& value)
+{
+    clear();
+    if(count > capacity_)
+        change_capacity(count);
+    mm::fill<Policy>(data_, count, value);
+    length_ = count;
+}
+
+template <typename T, size_t N, typename Policy>
+template <typename InputIt, typename>
+void small_rvector<T, N, Policy>::assign(InputIt first, InputIt last)
+{
+    size_t count = std::distance(first, last);
+    clear();
+    if(count > capacity_)
+        change_capacity(count);
+    mm::fill<Policy>(data_, first, last);
+    length_ = count;
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::assign(std::initializer_list<T> ilist)
+{
+    assign(ilist.begin(), ilist.end());
+}
+
+template <typename T, size_t N, typename Policy>
+template <typename Executor, typename>
+void small_rvector<T, N, Policy>::assign(Executor& ex, size_type count,
+                                         const T& value)
+{
+    clear();
+    if(count > capacity_)
+        change_capacity(count);
+    mm::parallel_fill<T, Policy>(ex, data_, count, value);
+    length_ = count;
+}
+
+template <typename T, size_t N, typename Policy>
+template <typename Executor, typename InputIt, typename, typename>
+void small_rvector<T, N, Policy>::assign(Executor& ex, InputIt first, InputIt last)
+{
+    size_t count = std::distance(first, last);
+    clear();
+    if(count > capacity_)
+        change_capacity(count);
+    mm::parallel_copy<T, Policy>(ex, data_, first, count);
+    length_ = count;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::size_type
+small_rvector<T, N, Policy>::size() const noexcept
+{
+    return length_;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::size_type
+small_rvector<T, N, Policy>::max_size() const noexcept
+{
+    return std::numeric_limits<size_type>::max() / sizeof(T);
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::resize(size_type size)
+{
+    if(size > capacity_)
+        change_capacity(size);
+    if(size < length_)
+    {
+        mm::destruct(data_ + size, data_ + length_);
+        if(!is_inline())
+            mm::trim<T, Policy>(data_, length_, size, capacity_);
+    }
+    else if(size > length_)
+        mm::fill<Policy>(data_ + length_, size - length_);
+    length_ = size;
+}
+
+// Resizes without initializing the new elements, which the caller
+// overwrites, and returns the first of them.
+template <typename T, size_t N, typename Policy>
+T* small_rvector<T, N, Policy>::resize_uninitialized(size_type size)
+{
+    static_assert(std::is_trivially_default_constructible<T>::value and
+                  std::is_trivially_destructible<T>::value,
+                  "uninitialized elements must be trivial");
+    if(size > capacity_)
+        change_capacity(size);
+    else if(size < length_ and !is_inline())
+        mm::trim<T, Policy>(data_, length_, size, capacity_);
+    T* tail = data_ + std::min(length_, size);
+    length_ = size;
+    return tail;
+}
+
+// Appends n uninitialized elements, growing geometrically like push_back,
+// and returns the first of them.
+template <typename T, size_t N, typename Policy>
+T* small_rvector<T, N, Policy>::append_uninitialized(size_type n)
+{
+    make_room(n);
+    return resize_uninitialized(length_ + n);
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::resize(size_type size, const T& c)
+{
+    if(size > capacity_)
+        change_capacity(size);
+    if(size < length_)
+    {
+        mm::destruct(data_ + size, data_ + length_);
+        if(!is_inline())
+            mm::trim<T, Policy>(data_, length_, size, capacity_);
+    }
+    else if(size > length_)
+        mm::fill<Policy>(data_ + length_, size - length_, c);
+    length_ = size;
+}
+
+template <typename T, size_t N, typename Policy>
+template <typename Executor, typename>
+void small_rvector<T, N, Policy>::resize(Executor& ex, size_type size, const T& c)
+{
+    if(size <= length_)
+        return resize(size, c);
+    if(size > capacity_)
+        change_capacity(size);
+    mm::parallel_fill<T, Policy>(ex, data_ + length_, size - length_, c);
+    length_ = size;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::size_type
+small_rvector<T, N, Policy>::capacity() const noexcept
+{
+    return capacity_;
+}
+
+template <typename T, size_t N, typename Policy>
+bool small_rvector<T, N, Policy>::empty() const noexcept
+{
+    return length_ == 0;
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::reserve(size_type n)
+{
+    if(n <= capacity_) return;
+    change_capacity(std::max(n, Policy::template grow<T>(capacity_)));
+}
+
+// Reserves as above and prefaults the spilled pages past the length in the
+// given mode.
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::reserve(size_type n, mm::prefault mode,
+                                          std::chrono::nanoseconds budget)
+{
+    reserve(n);
+    if(!is_inline() and mm::is_mapped<T, Policy>(capacity_))
+        mm::populate<Policy>(data_, length_*sizeof(T), capacity_*sizeof(T),
+                             mode, budget);
+}
+
+// Moves the elements back inline when they fit, otherwise shrinks the
+// spilled storage like rvector does.
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::shrink_to_fit()
+{
+    if(is_inline()) return;
+    if(length_ > N)
+    {
+        mm::shrink<T, Policy>(data_, length_, capacity_);
+        return;
+    }
+    T* old_data = data_;
+    size_type old_capacity = capacity_;
+    std::uninitialized_move_n(old_data, length_, inline_data());
+    mm::destruct(old_data, old_data + length_);
+    mm::deallocate<T, Policy>(old_data, old_capacity);
+    data_ = inline_data();
+    capacity_ = N;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::reference
+small_rvector<T, N, Policy>::operator[](size_type n)
+{
+    return data_[n];
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_reference
+small_rvector<T, N, Policy>::operator[](size_type n) const
+{
+    return data_[n];
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::reference
+small_rvector<T, N, Policy>::at(size_type n)
+{
+    if(UNLIKELY(n >= length_))
+        throw std::out_of_range("Index out of range: " + std::to_string(n));
+    return data_[n];
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_reference
+small_rvector<T, N, Policy>::at(size_type n) const
+{
+    if(UNLIKELY(n >= length_))
+        throw std::out_of_range("Index out of range: " + std::to_string(n));
+    return data_[n];
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::reference
+small_rvector<T, N, Policy>::front() noexcept
+{
+    return data_[0];
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_reference
+small_rvector<T, N, Policy>::front() const noexcept
+{
+    return data_[0];
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::reference
+small_rvector<T, N, Policy>::back() noexcept
+{
+    return data_[length_ - 1];
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::const_reference
+small_rvector<T, N, Policy>::back() const noexcept
+{
+    return data_[length_ - 1];
+}
+
+template <typename T, size_t N, typename Policy>
+T* small_rvector<T, N, Policy>::data() noexcept
+{
+    return data_;
+}
+
+template <typename T, size_t N, typename Policy>
+const T* small_rvector<T, N, Policy>::data() const noexcept
+{
+    return data_;
+}
+
+// NUMA node of each page holding the elements; see mm::page_nodes.
+template <typename T, size_t N, typename Policy>
+std::vector<int> small_rvector<T, N, Policy>::page_nodes() const
+{
+    return mm::page_nodes<Policy>(data_, length_*sizeof(T));
+}
+
+template <typename T, size_t N, typename Policy>
+template <class... Args>
+void small_rvector<T, N, Policy>::emplace_back(Args&&... args)
+{
+    grow();
+    new (data_ + length_) T(std::forward<Args>(args)...);
+    ++length_;
+}
+
+template <typename T, size_t N, typename Policy>
+template <class... Args>
+void small_rvector<T, N, Policy>::fast_emplace_back(Args&&... args)
+{
+    new (data_ + length_) T(std::forward<Args>(args)...);
+    ++length_;
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::push_back(const T& x)
+{
+    grow();
+    new (data_ + length_) T(x);
+    ++length_;
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::fast_push_back(const T& x)
+{
+    new (data_ + length_) T(x);
+    ++length_;
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::push_back(T&& x)
+{
+    grow();
+    new (data_ + length_) T(std::move(x));
+    ++length_;
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::fast_push_back(T&& x)
+{
+    new (data_ + length_) T(std::move(x));
+    ++length_;
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::pop_back() noexcept
+{
+    if constexpr(!std::is_trivially_destructible_v<T>)
+        back().~T();
+    --length_;
+    if(!is_inline())
+        mm::trim<T, Policy>(data_, length_ + 1, length_, capacity_);
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::safe_pop_back() noexcept
+{
+    if(length_ == 0) return;
+    pop_back();
+}
+
+template <typename T, size_t N, typename Policy>
+template <class... Args>
+typename small_rvector<T, N, Policy>::iterator
+small_rvector<T, N, Policy>::emplace(const_iterator position, Args&&... args)
+{
+    auto m = std::distance(cbegin(), position);
+    if(UNLIKELY(length_ == capacity_))
+    {
+        T* gap = grow_gap(m, 1);
+        new (gap) T(std::forward<Args>(args)...);
+        ++length_;
+        return gap;
+    }
+    iterator position_ = begin() + m;
+    mm::shiftr_data<Policy>(position_, (end() - position_));
+    new (position_) T(std::forward<Args>(args)...);
+    ++length_;
+    return position_;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::iterator
+small_rvector<T, N, Policy>::insert(iterator position, const T& x)
+{
+    return emplace(position, x);
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::iterator
+small_rvector<T, N, Policy>::insert(iterator position, T&& x)
+{
+    return emplace(position, std::move(x));
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::iterator
+small_rvector<T, N, Policy>::insert(iterator position, size_type n, const T& x)
+{
+    if(length_ + n > capacity_)
+    {
+        T* gap = grow_gap(position - data_, n);
+        std::uninitialized_fill(gap, gap + n, x);
+        length_ += n;
+        return gap;
+    }
+    auto end_ = end();
+    size_type rest = std::distance(position, end_);
+    if(rest > n) {
+        std::uninitialized_move(end_ - n, end_, end_);
+        std::move_backward(position, end_ - n, end_);
+        std::fill(position, position + n, x);
+    } else {
+        std::uninitialized_move(position, end_, position + n);
+        std::fill(position, end_, x);
+        std::uninitialized_fill(end_, position + n, x);
+    }
+    length_ += n;
+    return position;
+}
+
+template <typename T, size_t N, typename Policy>
+template <class InputIterator, typename>
+typename small_rvector<T, N, Policy>::iterator
+small_rvector<T, N, Policy>::insert(iterator position, InputIterator first,
+                                    InputIterator last)
+{
+    size_type n = std::distance(first, last);
+    if(length_ + n > capacity_)
+    {
+        T* gap = grow_gap(position - data_, n);
+        std::uninitialized_copy(first, last, gap);
+        length_ += n;
+        return gap;
+    }
+    auto end_ = end();
+    size_type rest = std::distance(position, end_);
+    if(rest > n) {
+        std::uninitialized_move(end_ - n, end_, end_);
+        std::move_backward(position, end_ - n, end_);
+        std::copy(first, last, position);
+    } else {
+        std::uninitialized_move(position, end_, position + n);
+        auto mid = std::next(first, rest);
+        std::copy(first, mid, position);
+        std::uninitialized_copy(mid, last, end_);
+    }
+    length_ += n;
+    return position;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::iterator
+small_rvector<T, N, Policy>::insert(iterator position, std::initializer_list<T> ilist)
+{
+    return insert(position, ilist.begin(), ilist.end());
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::iterator
+small_rvector<T, N, Policy>::erase(iterator position)
+{
+    if (position + 1 != end())
+        std::move(position + 1, end(), position);
+    pop_back();
+    return position;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::iterator
+small_rvector<T, N, Policy>::erase(iterator first, iterator last)
+{
+    auto n = std::distance(first, last);
+    if (last != end())
+        std::move(last, end(), first);
+    mm::destruct(end() - n, end());
+    length_ -= n;
+    if(!is_inline())
+        mm::trim<T, Policy>(data_, length_ + n, length_, capacity_);
+    return first;
+}
+
+// Moves the elements of other to the end, leaving it empty. Between two
+// spilled vectors this hands over pages as rvector::append does.
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::append(small_rvector<T, N, Policy>&& other)
+{
+    if(UNLIKELY(this == std::addressof(other)) or other.length_ == 0) return;
+    if(length_ == 0 and capacity_ <= other.capacity_)
+    {
+        swap(other);
+        return;
+    }
+    if(!is_inline() and !other.is_inline() and
+       mm::steal_pages<T, Policy>(data_, length_, capacity_,
+                                  other.data_, other.length_, other.capacity_))
+    {
+        length_ += other.length_;
+        other.data_ = other.inline_data();
+        other.length_ = 0;
+        other.capacity_ = N;
+        return;
+    }
+    insert(end(), std::make_move_iterator(other.begin()),
+           std::make_move_iterator(other.end()));
+    other.clear();
+}
+
+// Appends each of others in turn; see rvector::concat.
+template <typename T, size_t N, typename Policy>
+template <class... SmallRvectors>
+void small_rvector<T, N, Policy>::concat(SmallRvectors&&... others)
+{
+    static_assert((std::is_same_v<SmallRvectors, small_rvector> and ...),
+                  "concat takes small_rvector rvalues");
+    reserve(length_ + (others.size() + ... + 0));
+    (append(std::move(others)), ...);
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::swap(small_rvector<T, N, Policy>& other)
+{
+    if(!is_inline() and !other.is_inline())
+    {
+        using std::swap;
+        swap(data_, other.data_);
+        swap(length_, other.length_);
+        swap(capacity_, other.capacity_);
+        return;
+    }
+    small_rvector tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+}
+
+template <typename T, size_t N, typename Policy>
+void small_rvector<T, N, Policy>::clear() noexcept
+{
+    mm::destruct(data_, data_ + length_);
+    if(!is_inline())
+        mm::trim<T, Policy>(data_, length_, 0, capacity_);
+    length_ = 0;
+}
+
+template <typename T, size_t N, typename Policy>
+typename small_rvector<T, N, Policy>::size_type
+small_rvector<T, N, Policy>::map_threshold() noexcept
+{
+    return Policy::template map_threshold<T>();
+}
+
+
+template <class T, size_t N, class Policy>
+bool operator==(const small_rvector<T, N, Policy>& x,
+                const small_rvector<T, N, Policy>& y)
+{
+    if(x.size() != y.size()) return false;
+    return std::equal(x.begin(), x.end(), y.begin());
+}
+
+template <class T, size_t N, class Policy>
+bool operator< (const small_rvector<T, N, Policy>& x,
+                const small_rvector<T, N, Policy>& y)
+{
+    return std::lexicographical_compare(x.begin(), x.end(),
+                                        y.begin(), y.end());
+}
+
+template <class T, size_t N, class Policy>
+bool operator!=(const small_rvector<T, N, Policy>& x,
+                const small_rvector<T, N, Policy>& y)
+{
+    return !(x == y);
+}
+
+template <class T, size_t N, class Policy>
+bool operator> (const small_rvector<T, N, Policy>& x,
+                const small_rvector<T, N, Policy>& y)
+{
+    return y < x;
+}
+
+template <class T, size_t N, class Policy>
+bool operator>=(const small_rvector<T, N, Policy>& x,
+                const small_rvector<T, N, Policy>& y)
+{
+    return !(x < y);
+}
+
+template <class T, size_t N, class Policy>
+bool operator<=(const small_rvector<T, N, Policy>& x,
+                const small_rvector<T, N, Policy>& y)
+{
+    return !(y < x);
+}
+
+template <class T, size_t N, class Policy>
+void swap(small_rvector<T, N, Policy>& x, small_rvector<T, N, Policy>& y)
+{
+    x.swap(y);
+}
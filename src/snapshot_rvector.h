@@ -0,0 +1,390 @@
+#pragma once
+#include <atomic>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "allocator.h"
+
+// Vector with one writer and any number of concurrent readers. A reader
+// takes a snapshot, the data pointer and length at that moment, which
+// stays valid while the writer appends and grows. Mapped blocks grow in
+// place with mremap where they can; otherwise the elements are copied to
+// a new block and the old one is retired until no reader can still see
+// it. The block of epoch e is published in blocks_[e & 1] before the
+// epoch moves to e, and readers announce themselves in one of
+// reader_slots counters of that parity; a block retired when the epoch
+// left e is freed once the counters of e's parity drain. Elements the
+// snapshot covers must not be modified while readers may hold it.
+//
+// A snapshot costs three loads and an increment of the reader's counter,
+// and a decrement when the view goes away, more than the two loads of an
+// unguarded read. The counters are per thread slot and cache line, so
+// readers do not contend with each other, and unlike hazard pointers or a
+// grace period the writer never waits for readers to free a block.
+// runMicrobenchmarks reports the cost as "snapshot" next to "size".
+template<typename T, typename Policy = mm::default_policy>
+class snapshot_rvector
+{
+public:
+	using value_type = T;
+	using size_type = size_t;
+
+	using reference = T&;
+	using const_reference = const T&;
+
+	using iterator = T*;
+	using const_iterator = const T*;
+
+    // Elements [0, size()) as they were when the snapshot was taken.
+    class snapshot_view
+    {
+    public:
+        snapshot_view(snapshot_view&& other) noexcept;
+        snapshot_view(const snapshot_view&) = delete;
+        snapshot_view& operator =(const snapshot_view&) = delete;
+        ~snapshot_view();
+
+        const_iterator begin() const noexcept;
+        const_iterator end() const noexcept;
+        size_type size() const noexcept;
+        bool empty() const noexcept;
+        const_reference operator[](size_type n) const;
+        const_reference at(size_type n) const;
+        const T* data() const noexcept;
+    private:
+        friend class snapshot_rvector;
+
+        snapshot_view(std::atomic<size_type>* readers, const T* data,
+                      size_type length) noexcept;
+
+        std::atomic<size_type>* readers_;
+        const T* data_;
+        size_type length_;
+    };
+
+    snapshot_rvector() noexcept;
+    snapshot_rvector(const snapshot_rvector&) = delete;
+    snapshot_rvector& operator =(const snapshot_rvector&) = delete;
+    ~snapshot_rvector();
+
+    // Safe from any thread, concurrently with the writer.
+    snapshot_view snapshot() const noexcept;
+
+    // Writer side.
+    template <class... Args>
+    void emplace_back(Args&&... args);
+    void push_back(const T& x);
+    void push_back(T&& x);
+    void reserve(size_type n);
+    // Frees the retired blocks no reader can see any more.
+    void reclaim() noexcept;
+
+    size_type size() const noexcept;
+    size_type capacity() const noexcept;
+    bool empty() const noexcept;
+    const_reference operator[](size_type n) const;
+    const T* data() const noexcept;
+    size_type retired_blocks() const noexcept;
+private:
+    static constexpr size_type reader_slots = 64;
+
+    struct alignas(64) reader_slot
+    {
+        std::atomic<size_type> readers[2];
+    };
+
+    struct retired
+    {
+        T* data;
+        size_type length;
+        size_type capacity;
+        size_type epoch;
+    };
+
+    static size_type slot_index() noexcept;
+    void change_capacity(size_type n);
+    void free_block(T* data, size_type length, size_type capacity) noexcept;
+
+    std::atomic<T*> data_;
+    std::atomic<T*> blocks_[2];
+    std::atomic<size_type> length_;
+    size_type capacity_;
+    std::atomic<size_type> epoch_;
+    mutable reader_slot slots_[reader_slots];
+    std::vector<retired> retired_;
+};
+
+template<typename T, typename Policy>
+snapshot_rvector<T, Policy>::snapshot_view::snapshot_view(
+        std::atomic<size_type>* readers, const T* data, size_type length) noexcept
+ : readers_(readers),
+ data_(data),
+ length_(length)
+{
+}
+
+template<typename T, typename Policy>
+snapshot_rvector<T, Policy>::snapshot_view::snapshot_view(
+        snapshot_view&& other) noexcept
+ : readers_(other.readers_),
+ data_(other.data_),
+ length_(other.length_)
+{
+    other.readers_ = nullptr;
+}
+
+template<typename T, typename Policy>
+snapshot_rvector<T, Policy>::snapshot_view::~snapshot_view()
+{
+    if(readers_)
+        readers_->fetch_sub(1, std::memory_order_release);
+}
+
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::const_iterator
+snapshot_rvector<T, Policy>::snapshot_view::begin() const noexcept
+{
+    return data_;
+}
+
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::const_iterator
+snapshot_rvector<T, Policy>::snapshot_view::end() const noexcept
+{
+    return data_ + length_;
+}
+
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::size_type
+snapshot_rvector<T, Policy>::snapshot_view::size() const noexcept
+{
+    return length_;
+}
+
+template<typename T, typename Policy>
+bool snapshot_rvector<T, Policy>::snapshot_view::empty() const noexcept
+{
+    return length_ == 0;
+}
+
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::const_reference
+snapshot_rvector<T, Policy>::snapshot_view::operator[](size_type n) const
+{
+    return data_[n];
+}
+
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::const_reference
+snapshot_rvector<T, Policy>::snapshot_view::at(size_type n) const
+{
+    if(UNLIKELY(n >= length_))
+        throw std::out_of_range("Index out of range: " + std::to_string(n));
+    return data_[n];
+}
+
+template<typename T, typename Policy>
+const T* snapshot_rvector<T, Policy>::snapshot_view::data() const noexcept
+{
+    return data_;
+}
+
+template<typename T, typename Policy>
+snapshot_rvector<T, Policy>::snapshot_rvector() noexcept
+ : data_(nullptr),
+ blocks_(),
+ length_(0),
+ capacity_(0),
+ epoch_(0),
+ slots_()
+{
+}
+
+template<typename T, typename Policy>
+snapshot_rvector<T, Policy>::~snapshot_rvector()
+{
+    for(const retired& r : retired_)
+        free_block(r.data, r.length, r.capacity);
+    free_block(data_.load(), length_.load(), capacity_);
+}
+
+// Threads spread over the slots in the order they first read.
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::size_type
+snapshot_rvector<T, Policy>::slot_index() noexcept
+{
+    static std::atomic<size_type> next(0);
+    thread_local size_type index = next.fetch_add(1) % reader_slots;
+    return index;
+}
+
+// The reader counts itself under the epoch it saw and reads the length
+// and that epoch's block; if the epoch moved meanwhile it may be counted
+// under the parity of a block retired before the one it reads, or read a
+// length past the block, and tries again. While the epoch stays e the
+// block of e is current and holds the published length.
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::snapshot_view
+snapshot_rvector<T, Policy>::snapshot() const noexcept
+{
+    reader_slot& slot = slots_[slot_index()];
+    for(;;)
+    {
+        size_type epoch = epoch_.load();
+        std::atomic<size_type>* readers = &slot.readers[epoch & 1];
+        readers->fetch_add(1);
+        size_type length = length_.load();
+        const T* data = blocks_[epoch & 1].load();
+        if(epoch_.load() == epoch)
+            return snapshot_view(readers, data, length);
+        readers->fetch_sub(1);
+    }
+}
+
+template<typename T, typename Policy>
+void snapshot_rvector<T, Policy>::free_block(T* data, size_type length,
+                                             size_type capacity) noexcept
+{
+    if(!data) return;
+    mm::destruct(data, data + length);
+    mm::deallocate<T, Policy>(data, capacity);
+}
+
+// Grows a mapped block where it lies, or copies the elements to a new
+// block and retires the old one; readers may still be inside it, so the
+// elements are copied rather than moved. The caller reclaims once it is
+// done with arguments that may point into the old block.
+template<typename T, typename Policy>
+void snapshot_rvector<T, Policy>::change_capacity(size_type n)
+{
+    T* data = data_.load(std::memory_order_relaxed);
+    size_type length = length_.load(std::memory_order_relaxed);
+    n = mm::fix_capacity<T, Policy>(n);
+    if(data and mm::is_mapped<T, Policy>(capacity_) and
+       mm::is_mapped<T, Policy>(n) and Policy::reserve_bytes == 0 and
+       !Policy::copy_on_write and
+       mm::remap_<T, Policy>(data, capacity_*sizeof(T), n*sizeof(T), 0)
+            != MAP_FAILED)
+    {
+        mm::telemetry::add<T>(mm::telemetry::inplace_remaps);
+        capacity_ = n;
+        return;
+    }
+    retired_.reserve(retired_.size() + 1);
+    T* new_data = mm::allocate<T, Policy>(n);
+    try
+    {
+        std::uninitialized_copy_n(data, length, new_data);
+    }
+    catch(...)
+    {
+        mm::deallocate<T, Policy>(new_data, n);
+        throw;
+    }
+    mm::telemetry::add<T>(mm::telemetry::fallback_copies);
+    mm::telemetry::add<T>(mm::telemetry::bytes_copied, length*sizeof(T));
+    size_type epoch = epoch_.load(std::memory_order_relaxed);
+    blocks_[(epoch + 1) & 1].store(new_data);
+    data_.store(new_data);
+    epoch_.fetch_add(1);
+    if(data)
+        retired_.push_back(retired{data, length, capacity_, epoch});
+    capacity_ = n;
+}
+
+template<typename T, typename Policy>
+void snapshot_rvector<T, Policy>::reclaim() noexcept
+{
+    bool drained[2];
+    for(int parity = 0; parity < 2; ++parity)
+    {
+        drained[parity] = true;
+        for(const reader_slot& slot : slots_)
+            drained[parity] = drained[parity] and slot.readers[parity].load() == 0;
+    }
+    auto kept = std::remove_if(retired_.begin(), retired_.end(),
+        [&](const retired& r) {
+            if(!drained[r.epoch & 1]) return false;
+            free_block(r.data, r.length, r.capacity);
+            return true;
+        });
+    retired_.erase(kept, retired_.end());
+}
+
+template<typename T, typename Policy>
+template <class... Args>
+void snapshot_rvector<T, Policy>::emplace_back(Args&&... args)
+{
+    size_type length = length_.load(std::memory_order_relaxed);
+    bool grown = length == capacity_;
+    if(UNLIKELY(grown))
+        change_capacity(Policy::template grow<T>(capacity_));
+    new (data_.load(std::memory_order_relaxed) + length)
+        T(std::forward<Args>(args)...);
+    length_.store(length + 1, std::memory_order_release);
+    if(UNLIKELY(grown))
+        reclaim();
+}
+
+template<typename T, typename Policy>
+void snapshot_rvector<T, Policy>::push_back(const T& x)
+{
+    emplace_back(x);
+}
+
+template<typename T, typename Policy>
+void snapshot_rvector<T, Policy>::push_back(T&& x)
+{
+    emplace_back(std::move(x));
+}
+
+template<typename T, typename Policy>
+void snapshot_rvector<T, Policy>::reserve(size_type n)
+{
+    if(n <= capacity_) return;
+    change_capacity(n);
+    reclaim();
+}
+
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::size_type
+snapshot_rvector<T, Policy>::size() const noexcept
+{
+    return length_.load(std::memory_order_acquire);
+}
+
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::size_type
+snapshot_rvector<T, Policy>::capacity() const noexcept
+{
+    return capacity_;
+}
+
+template<typename T, typename Policy>
+bool snapshot_rvector<T, Policy>::empty() const noexcept
+{
+    return size() == 0;
+}
+
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::const_reference
+snapshot_rvector<T, Policy>::operator[](size_type n) const
+{
+    return data_.load(std::memory_order_relaxed)[n];
+}
+
+template<typename T, typename Policy>
+const T* snapshot_rvector<T, Policy>::data() const noexcept
+{
+    return data_.load(std::memory_order_relaxed);
+}
+
+template<typename T, typename Policy>
+typename snapshot_rvector<T, Policy>::size_type
+snapshot_rvector<T, Policy>::retired_blocks() const noexcept
+{
+    return retired_.size();
+}
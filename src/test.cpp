@@ -1,6 +1,12 @@
 #include "rvector.h"
+#include "small_rvector.h"
+#include "persistent_rvector.h"
+#include "concurrent_rvector.h"
+#include "snapshot_rvector.h"
+#include "traced_rvector.h"
 #include <gtest/gtest.h>
 #include <string>
+#include <thread>
 #include <boost/preprocessor/repetition/repeat.hpp>
 #include "test_type.h"
 
@@ -585,4 +591,1567 @@ TEST(rvector_test, guides_test)
 	rvector v3(v2.begin(), v2.end());
 	rvector v4(v3);
 	rvector v5(std::move(v4));
-}
\ No newline at end of file
+}
+
+struct Reserved
+{
+	int n = 0;
+	std::string s = {};
+
+	bool operator == (const Reserved& other) const {
+		return n == other.n and s == other.s;
+	}
+};
+
+struct reserved_policy : mm::basic_policy<reserved_policy>
+{
+	static constexpr mm::size_type reserve_bytes = 1 << 20;
+};
+
+template<typename T>
+class rvector_reserved_test : public ::testing::Test
+{
+};
+
+using ReservedTypes = ::testing::Types<int64_t, Reserved>;
+TYPED_TEST_CASE(rvector_reserved_test, ReservedTypes);
+
+TYPED_TEST(rvector_reserved_test, grow_in_place)
+{
+	const size_t fits = reserved_policy::reserve_bytes / sizeof(TypeParam) / 2;
+	rvector<TypeParam, reserved_policy> v(big_size);
+	auto p = v.data();
+	for(size_t i = big_size; i < fits; ++i)
+		v.push_back(TypeParam{(int) i});
+	EXPECT_EQ(v.data(), p);
+	v.resize(fits * 2 - 1);
+	EXPECT_EQ(v.data(), p);
+	v.resize(fits);
+
+	for(size_t i = fits; i < fits * 3; ++i)
+		v.push_back(TypeParam{(int) i});
+	EXPECT_EQ(v.size(), fits * 3);
+	for(size_t i = big_size; i < v.size(); ++i)
+		EXPECT_EQ(v[i], TypeParam{(int) i});
+
+	p = v.data();
+	v.resize(fits);
+	v.shrink_to_fit();
+	EXPECT_EQ(v.data(), p);
+	for(size_t i = fits; i < fits * 2; ++i)
+		v.push_back(TypeParam{(int) i});
+	EXPECT_EQ(v.data(), p);
+	for(size_t i = big_size; i < v.size(); ++i)
+		EXPECT_EQ(v[i], TypeParam{(int) i});
+}
+
+struct Huge
+{
+	int n = 0;
+
+	bool operator == (const Huge& other) const {
+		return n == other.n;
+	}
+};
+
+struct huge_policy : mm::basic_policy<huge_policy>
+{
+	static constexpr bool huge_pages = true;
+};
+
+TEST(rvector_huge_test, aligned_growth)
+{
+	const size_t threshold = huge_policy::huge_threshold<Huge>();
+	rvector<Huge, huge_policy> v;
+	for(int i = 0; i < (int) threshold * 3; ++i)
+	{
+		v.push_back(Huge{i});
+		if(v.capacity() >= threshold)
+		{
+			EXPECT_EQ((size_t) v.data() % mm::huge_page_size, 0u);
+			EXPECT_EQ(v.capacity() * sizeof(Huge) % mm::huge_page_size, 0u);
+		}
+	}
+	for(int i = 0; i < (int) v.size(); ++i)
+		EXPECT_EQ(v[i].n, i);
+}
+
+struct page_16k_policy : mm::basic_policy<page_16k_policy>
+{
+	static mm::size_type page_size() noexcept
+	{
+		return 16 << 10;
+	}
+};
+
+TEST(rvector_policy_test, page_size)
+{
+	EXPECT_EQ((rvector<int, page_16k_policy>::map_threshold()), 4096u);
+	EXPECT_EQ(rvector<int>::map_threshold(), 
+				mm::default_policy::page_size() / sizeof(int));
+
+	rvector<int, page_16k_policy> v;
+	for(int i = 0; i < 10000; ++i)
+		v.push_back(i);
+	EXPECT_EQ(v.capacity() % 4096, 0u);
+	for(int i = 0; i < 10000; ++i)
+		EXPECT_EQ(v[i], i);
+}
+
+TEST(rvector_policy_test, big_elements)
+{
+	using Page = std::array<char, 5000>;
+	EXPECT_EQ(rvector<Page>::map_threshold(), 1u);
+
+	rvector<Page> v;
+	for(int i = 0; i < 100; ++i)
+	{
+		v.emplace_back();
+		v.back()[0] = i;
+	}
+	for(int i = 0; i < 100; ++i)
+		EXPECT_EQ(v[i][0], i);
+}
+
+TEST(rvector_policy_test, compact_growth)
+{
+	const size_t step = mm::compact_policy::linear_step / sizeof(int);
+	rvector<int, mm::compact_policy> v;
+	size_t capacity = 0;
+	for(size_t i = 0; i < step * 3; ++i)
+	{
+		v.push_back(i);
+		if(v.capacity() == capacity) continue;
+		if(capacity > 64 and v.capacity() < v.map_threshold())
+		{
+			EXPECT_LE(v.capacity(), capacity * 3 / 2 + 1);
+		}
+		if(capacity >= step)
+		{
+			EXPECT_LE(v.capacity(), capacity + step + v.map_threshold());
+		}
+		capacity = v.capacity();
+	}
+	for(size_t i = 0; i < step * 3; ++i)
+		EXPECT_EQ(v[i], (int) i);
+}
+
+static_assert(mm::is_trivially_relocatable<int>::value);
+static_assert(mm::is_trivially_relocatable<rvector<std::string>>::value);
+static_assert(mm::is_trivially_relocatable<std::unique_ptr<int>>::value);
+static_assert(mm::is_trivially_relocatable<
+	std::pair<std::shared_ptr<int>, std::array<int, 3>>>::value);
+static_assert(!mm::is_trivially_relocatable<TestType>::value);
+
+TEST(rvector_relocate_test, unique_ptr)
+{
+	rvector<std::unique_ptr<int>> v;
+	for(int i = 0; i < 100000; ++i)
+		v.push_back(std::make_unique<int>(i));
+	v.insert(v.begin() + 7, std::make_unique<int>(-1));
+	EXPECT_EQ(*v[7], -1);
+	v.erase(v.begin() + 7);
+	for(int i = 0; i < 100000; ++i)
+		EXPECT_EQ(*v[i], i);
+}
+
+TEST(rvector_relocate_test, nested)
+{
+	rvector<rvector<std::string>> v;
+	for(int i = 0; i < 10000; ++i)
+	{
+		v.emplace_back();
+		for(int j = 0; j < i % 7; ++j)
+			v.back().push_back(init_value<std::string>(j));
+	}
+	for(int i = 0; i < 10000; ++i)
+	{
+		EXPECT_EQ(v[i].size(), (size_t) i % 7);
+		for(int j = 0; j < i % 7; ++j)
+			EXPECT_EQ(v[i][j], init_value<std::string>(j));
+	}
+}
+
+struct Counted
+{
+	int n = 0;
+};
+
+TEST(rvector_telemetry_test, counters)
+{
+	using namespace mm::telemetry;
+	reset<Counted>();
+	{
+		rvector<Counted> v;
+		for(int i = 0; i < 100000; ++i)
+			v.push_back(Counted{i});
+	}
+	std::thread([] {
+		rvector<Counted> v(big_size);
+		v.resize(big_size * 100);
+	}).join();
+
+	stats s = snapshot<Counted>();
+	EXPECT_EQ(s.count[map_transitions], 1u);
+	EXPECT_GT(s.count[inplace_remaps] + s.count[page_moves], 0u);
+	EXPECT_GE(s.count[fallback_copies], 1u);
+	EXPECT_GE(s.count[bytes_copied], 
+			s.count[fallback_copies] * sizeof(Counted));
+
+	uint64_t mmaps = 0, munmaps = 0;
+	for(size_t b = 0; b < buckets; ++b)
+	{
+		mmaps += s.latency[sys_mmap][b];
+		munmaps += s.latency[sys_munmap][b];
+	}
+	EXPECT_EQ(mmaps, 2u);
+	EXPECT_EQ(munmaps, 2u);
+
+	reset<Counted>();
+	EXPECT_EQ(snapshot<Counted>().count[map_transitions], 0u);
+}
+
+TYPED_TEST(rvector_test, shrink_to_fit)
+{
+	rvector<TypeParam> v;
+	for(size_t i = 0; i < big_size * 16; i++)
+		v.push_back(init_value<TypeParam>(i));
+	v.resize(big_size);
+	v.shrink_to_fit();
+	EXPECT_LT(v.capacity(), big_size * 2);
+	EXPECT_GE(v.capacity(), big_size);
+
+	v.resize(5);
+	v.shrink_to_fit();
+	EXPECT_LT(v.capacity(), v.map_threshold());
+	EXPECT_EQ(v.size(), 5u);
+	for(size_t i = 0; i < v.size(); i++)
+		EXPECT_EQ(v[i], init_value<TypeParam>(i));
+
+	v.push_back(init_value<TypeParam>(5));
+	EXPECT_EQ(v[5], init_value<TypeParam>(5));
+}
+
+struct auto_shrink_policy : mm::basic_policy<auto_shrink_policy>
+{
+	static constexpr mm::size_type shrink_ratio = 4;
+};
+
+TYPED_TEST(rvector_test, auto_shrink)
+{
+	rvector<TypeParam, auto_shrink_policy> v;
+	for(size_t i = 0; i < big_size * 64; i++)
+		v.push_back(init_value<TypeParam>(i));
+	size_t capacity = v.capacity();
+
+	while(v.size() > big_size)
+		v.pop_back();
+	EXPECT_LE(v.capacity(), capacity / 8);
+	EXPECT_GE(v.capacity(), v.size());
+
+	v.erase(v.begin() + 10, v.end());
+	v.clear();
+	EXPECT_LE(v.capacity(), 2 * v.map_threshold() + 64);
+	v.push_back(init_value<TypeParam>(1));
+	EXPECT_EQ(v[0], init_value<TypeParam>(1));
+}
+
+struct release_policy : mm::basic_policy<release_policy>
+{
+	static constexpr mm::size_type release_bytes = 1 << 16;
+	static constexpr int release_advice = MADV_DONTNEED;
+};
+
+size_t resident_pages(const void* begin, size_t bytes)
+{
+	size_t page = mm::default_policy::page_size();
+	std::vector<unsigned char> pages((bytes + page - 1) / page);
+	mincore((void*) begin, bytes, pages.data());
+	return std::count_if(pages.begin(), pages.end(), 
+						[](unsigned char c) { return c & 1; });
+}
+
+TEST(rvector_release_test, pop_back_and_clear)
+{
+	const size_t n = 1 << 20;
+	const size_t page = mm::default_policy::page_size();
+	rvector<int, release_policy> v(n, 1);
+	size_t bytes = v.capacity() * sizeof(int);
+	EXPECT_GE(resident_pages(v.data(), bytes), n * sizeof(int) / page);
+
+	while(v.size() > n / 2)
+		v.pop_back();
+	EXPECT_LE(resident_pages(v.data(), bytes), n / 2 * sizeof(int) / page + 
+				release_policy::release_bytes / page + 1);
+
+	v.clear();
+	EXPECT_EQ(resident_pages(v.data(), bytes), 0u);
+	v.resize(n, 2);
+	EXPECT_EQ(v[n - 1], 2);
+}
+
+struct prefault_policy : mm::basic_policy<prefault_policy>
+{
+	static constexpr mm::prefault prefault_mode = mm::prefault::populate;
+};
+
+TEST(rvector_prefault_test, reserve)
+{
+	const size_t n = 1 << 20;
+	const size_t page = mm::default_policy::page_size();
+	rvector<int> v;
+	v.reserve(n, mm::prefault::populate);
+	EXPECT_GE(resident_pages(v.data(), n * sizeof(int)), n * sizeof(int) / page);
+
+	rvector<int> w;
+	w.reserve(n, mm::prefault::chunked, std::chrono::nanoseconds(0));
+	EXPECT_GE(resident_pages(w.data(), n * sizeof(int)), 
+				mm::prefault_chunk / page);
+	for(int i = 0; i < (int) n; ++i)
+		w.push_back(i);
+	EXPECT_EQ(w[n - 1], (int) n - 1);
+}
+
+TEST(rvector_prefault_test, policy_growth)
+{
+	const size_t page = mm::default_policy::page_size();
+	rvector<int, prefault_policy> v;
+	for(int i = 0; i < 1 << 20; ++i)
+		v.push_back(i);
+	size_t bytes = v.capacity() * sizeof(int);
+	EXPECT_GE(resident_pages(v.data(), bytes), bytes / page);
+	for(int i = 0; i < (int) v.size(); ++i)
+		EXPECT_EQ(v[i], i);
+}
+
+struct cache_policy : mm::basic_policy<cache_policy>
+{
+	static constexpr size_t cache_bytes = 16 << 20;
+};
+
+TEST(rvector_cache_test, reuse_and_trim)
+{
+	using cache = mm::mapping_cache<cache_policy>;
+	const size_t n = 1 << 20;
+	cache::trim();
+	mm::telemetry::reset<int>();
+	int* p;
+	size_t bytes;
+	{
+		rvector<int, cache_policy> v(n, 1);
+		p = v.data();
+		bytes = mm::page_round<cache_policy>(v.capacity() * sizeof(int));
+	}
+	EXPECT_EQ(cache::cached_bytes(), bytes);
+	{
+		rvector<int, cache_policy> v(n, 2);
+		EXPECT_EQ(v.data(), p);
+		EXPECT_EQ(v[n - 1], 2);
+		EXPECT_EQ(cache::cached_bytes(), 0u);
+	}
+	EXPECT_EQ(mm::telemetry::snapshot<int>().count[mm::telemetry::cache_hits], 1u);
+
+	{
+		rvector<int, cache_policy> v(cache_policy::cache_bytes / sizeof(int) + 1);
+	}
+	EXPECT_EQ(cache::cached_bytes(), bytes);
+	{
+		rvector<int, cache_policy> a(n * 2), b(n * 2);
+	}
+	EXPECT_LE(cache::cached_bytes(), cache_policy::cache_bytes);
+	cache::trim();
+	EXPECT_EQ(cache::cached_bytes(), 0u);
+}
+
+TEST(rvector_cache_test, reuse_across_sizes)
+{
+	using cache = mm::mapping_cache<cache_policy>;
+	using namespace mm::telemetry;
+	const size_t n = 1 << 20;
+	cache::trim();
+	reset<int>();
+	int* p;
+	size_t bytes;
+	{
+		rvector<int, cache_policy> v(n, 1);
+		p = v.data();
+		bytes = mm::page_round<cache_policy>(v.capacity() * sizeof(int));
+	}
+	size_t small = 0;
+	{
+		rvector<int, cache_policy> v(n * 3 / 4, 2);
+		EXPECT_EQ(v.data(), p);
+		EXPECT_EQ(v.back(), 2);
+		small = mm::page_round<cache_policy>(v.capacity() * sizeof(int));
+		EXPECT_EQ(cache::cached_bytes(), bytes - small);
+		// Too small to split off the remainder without wasting half of it.
+		rvector<int, cache_policy> w(n / 64, 3);
+		EXPECT_NE(w.data(), p + small / sizeof(int));
+	}
+	EXPECT_EQ(snapshot<int>().count[cache_hits], 1u);
+	{
+		rvector<int, cache_policy> v(n / 8, 4);
+		EXPECT_EQ(v.data(), p + small / sizeof(int));
+		EXPECT_EQ(v.back(), 4);
+		v.resize(n * 2, 5);
+		EXPECT_EQ(v[n / 8 - 1], 4);
+		EXPECT_EQ(v.back(), 5);
+	}
+	EXPECT_EQ(snapshot<int>().count[cache_hits], 2u);
+	cache::trim();
+	EXPECT_EQ(cache::cached_bytes(), 0u);
+}
+
+TEST(rvector_cache_test, other_thread)
+{
+	using cache = mm::mapping_cache<cache_policy>;
+	const size_t n = 1 << 20;
+	rvector<int, cache_policy> v(n, 3);
+	size_t bytes = mm::page_round<cache_policy>(v.capacity() * sizeof(int));
+	std::thread([&] {
+		rvector<int, cache_policy> w(std::move(v));
+		EXPECT_EQ(w[n - 1], 3);
+		{
+			rvector<int, cache_policy> drop(std::move(w));
+		}
+		EXPECT_EQ(cache::cached_bytes(), bytes);
+	}).join();
+	EXPECT_EQ(cache::cached_bytes(), 0u);
+}
+
+TEST(small_rvector_test, inline_and_spill)
+{
+	small_rvector<std::string, 4> v;
+	auto inline_data = v.data();
+	for(int i = 0; i < 4; ++i)
+		v.push_back(init_value<std::string>(i));
+	EXPECT_TRUE(v.is_inline());
+	EXPECT_EQ(v.data(), inline_data);
+	EXPECT_EQ(v.capacity(), 4u);
+
+	for(int i = 4; i < 100; ++i)
+		v.push_back(init_value<std::string>(i));
+	EXPECT_FALSE(v.is_inline());
+	for(int i = 0; i < 100; ++i)
+		EXPECT_EQ(v[i], init_value<std::string>(i));
+
+	v.erase(v.begin() + 3, v.end());
+	v.shrink_to_fit();
+	EXPECT_TRUE(v.is_inline());
+	EXPECT_EQ(v, (small_rvector<std::string, 4>{"test0", "test1", "test2"}));
+}
+
+TEST(small_rvector_test, move_and_swap)
+{
+	small_rvector<std::string, 4> a{"a", "b"};
+	small_rvector<std::string, 4> b(10, "c");
+	small_rvector<std::string, 4> c(std::move(a));
+	EXPECT_TRUE(a.empty());
+	EXPECT_TRUE(c.is_inline());
+	EXPECT_EQ(c.back(), "b");
+
+	auto heap = b.data();
+	c.swap(b);
+	EXPECT_EQ(c.data(), heap);
+	EXPECT_EQ(c.size(), 10u);
+	EXPECT_EQ(b, (small_rvector<std::string, 4>{"a", "b"}));
+
+	b = std::move(c);
+	EXPECT_EQ(b.data(), heap);
+	EXPECT_TRUE(c.is_inline());
+	c = b;
+	EXPECT_EQ(c, b);
+
+	c.insert(c.begin() + 1, {"x", "y"});
+	EXPECT_EQ(c[2], "y");
+	EXPECT_EQ(c.size(), 12u);
+}
+
+TEST(small_rvector_test, nested)
+{
+	rvector<small_rvector<int, 8>> rows(1000);
+	for(int i = 0; i < 1000; ++i)
+		for(int j = 0; j < i % 12; ++j)
+			rows[i].push_back(j);
+	rows.insert(rows.begin(), small_rvector<int, 8>{1, 2, 3});
+	for(int i = 0; i < 1000; ++i)
+	{
+		EXPECT_EQ(rows[i + 1].size(), size_t(i % 12));
+		EXPECT_EQ(rows[i + 1].is_inline(), i % 12 <= 8);
+	}
+	EXPECT_EQ(rows[0].back(), 3);
+}
+
+TEST(small_rvector_test, rvector_surface)
+{
+	mm::thread_executor ex(2);
+	small_rvector<std::string, 4> s(ex, 3, "x");
+	EXPECT_TRUE(s.is_inline());
+	s.resize(ex, 50, "y");
+	EXPECT_FALSE(s.is_inline());
+	EXPECT_EQ(s[2], "x");
+	EXPECT_EQ(s[49], "y");
+	small_rvector<std::string, 4> t(ex, s);
+	EXPECT_EQ(t, s);
+	t.assign(ex, 2, "z");
+	EXPECT_EQ(t, (small_rvector<std::string, 4>{"z", "z"}));
+
+	small_rvector<int, 8> a;
+	for(int i = 0; i < 8; ++i)
+		*a.append_uninitialized(1) = i;
+	EXPECT_TRUE(a.is_inline());
+	int* tail = a.append_uninitialized((1 << 20) - 8);
+	EXPECT_FALSE(a.is_inline());
+	for(int i = 0; i < (1 << 20) - 8; ++i)
+		tail[i] = i + 8;
+	a.reserve(1 << 21, mm::prefault::populate);
+	EXPECT_GE(a.capacity(), size_t(1 << 21));
+
+	const int page_ints = mm::default_policy::page_size() / sizeof(int);
+	small_rvector<int, 8> b;
+	for(int i = 0; i < page_ints * 16; ++i)
+		b.push_back(int(a.size()) + i);
+	size_t total = a.size() + b.size();
+	mm::telemetry::reset<int>();
+	a.append(std::move(b));
+	EXPECT_EQ(mm::telemetry::snapshot<int>().count[mm::telemetry::page_moves], 1u);
+	EXPECT_TRUE(b.empty());
+	EXPECT_TRUE(b.is_inline());
+	ASSERT_EQ(a.size(), total);
+	for(size_t i = 0; i < total; ++i)
+		ASSERT_EQ(a[i], int(i));
+
+	small_rvector<int, 8> c{1, 2};
+	small_rvector<int, 8> d{3};
+	c.append(std::move(d));
+	EXPECT_EQ(c, (small_rvector<int, 8>{1, 2, 3}));
+	EXPECT_EQ(a.resize_uninitialized(4), a.data() + 4);
+	EXPECT_EQ(a.size(), 4u);
+}
+
+struct counted_move
+{
+	static inline int moves = 0;
+	int value;
+
+	counted_move(int v) : value(v) {}
+	counted_move(const counted_move&) = default;
+	counted_move(counted_move&& other) noexcept : value(other.value) { ++moves; }
+	counted_move& operator=(const counted_move&) = default;
+	counted_move& operator=(counted_move&& other) noexcept
+	{
+		value = other.value;
+		++moves;
+		return *this;
+	}
+};
+
+TEST(small_rvector_test, single_pass_growth)
+{
+	small_rvector<counted_move, 4> v;
+	for(int i = 0; i < 4; ++i)
+		v.emplace_back(i);
+	counted_move::moves = 0;
+	v.emplace(v.begin(), -1);
+	EXPECT_EQ(counted_move::moves, 4);
+	EXPECT_FALSE(v.is_inline());
+	v.resize(v.capacity(), counted_move(9));
+	size_t length = v.size();
+	counted_move::moves = 0;
+	std::vector<counted_move> more(3, counted_move(-2));
+	v.insert(v.begin() + 1, more.begin(), more.end());
+	EXPECT_EQ(counted_move::moves, int(length));
+	EXPECT_EQ(v[0].value, -1);
+	EXPECT_EQ(v[3].value, -2);
+	EXPECT_EQ(v[4].value, 0);
+	EXPECT_EQ(v.back().value, 9);
+
+	small_rvector<int, 8> a{1, 2}, b{3}, c(100, 4);
+	a.concat(std::move(b), std::move(c));
+	EXPECT_EQ(a.size(), 103u);
+	EXPECT_EQ(a[2], 3);
+	EXPECT_EQ(a.back(), 4);
+	size_t pages = a.page_nodes().size();
+	EXPECT_TRUE(pages == 1 or pages == 2) << pages;
+	EXPECT_EQ((small_rvector<int, 8>::map_threshold()), rvector<int>::map_threshold());
+}
+
+TEST(rvector_pmr_test, arena_in_place_growth)
+{
+	mm::arena_resource<> arena(64 << 20);
+	mm::telemetry::reset<int>();
+	rvector<int, mm::pmr_policy> a(&arena);
+	for(int i = 0; i < 1 << 20; ++i)
+		a.push_back(i);
+	auto stats = mm::telemetry::snapshot<int>();
+	EXPECT_EQ(stats.count[mm::telemetry::fallback_copies], 0u);
+	EXPECT_LE(arena.used(), a.capacity() * sizeof(int) + mm::resource_header);
+
+	rvector<std::string, mm::pmr_policy> b(&arena);
+	for(int i = 0; i < 1000; ++i)
+		b.push_back(init_value<std::string>(i));
+	a.push_back(-1);
+	for(int i = 0; i < 1 << 20; ++i)
+		EXPECT_EQ(a[i], i);
+	EXPECT_EQ(a.back(), -1);
+	for(int i = 0; i < 1000; ++i)
+		EXPECT_EQ(b[i], init_value<std::string>(i));
+
+	rvector<std::string, mm::pmr_policy> copy(b);
+	EXPECT_EQ(copy, b);
+	EXPECT_EQ(mm::resource_of(copy.data()), std::pmr::get_default_resource());
+	EXPECT_EQ(mm::resource_of(b.data()), &arena);
+}
+
+TEST(rvector_pmr_test, release)
+{
+	mm::arena_resource<> arena(1 << 20);
+	{
+		rvector<int, mm::pmr_policy> a(&arena);
+		a.resize(1000, 7);
+	}
+	EXPECT_EQ(arena.used(), 0u);
+
+	{
+		rvector<int, mm::pmr_policy> a(&arena), b(&arena);
+		a.resize(100, 1);
+		b.resize(100, 2);
+		EXPECT_THROW(a.resize(1 << 20), std::bad_alloc);
+		EXPECT_EQ(a[99], 1);
+		EXPECT_EQ(b[99], 2);
+		b.clear();
+	}
+	EXPECT_GT(arena.used(), 0u);
+	arena.release();
+	EXPECT_EQ(arena.used(), 0u);
+
+	rvector<int, mm::pmr_policy> c(&arena);
+	c.push_back(3);
+	EXPECT_EQ(c[0], 3);
+}
+
+TEST(rvector_pmr_test, empty_and_moved_from)
+{
+	mm::arena_resource<> arena(1 << 20);
+	{
+		rvector<int, mm::pmr_policy> empty;
+		EXPECT_TRUE(empty.empty());
+	}
+	{
+		rvector<int, mm::pmr_policy> a(&arena);
+		a.resize(100, 1);
+		rvector<int, mm::pmr_policy> b(std::move(a));
+		EXPECT_EQ(b[99], 1);
+		rvector<int, mm::pmr_policy> c;
+		c = std::move(b);
+		EXPECT_EQ(c.size(), 100u);
+	}
+	EXPECT_EQ(arena.used(), 0u);
+}
+
+struct Record
+{
+	int64_t id;
+	double value;
+};
+
+TEST(persistent_rvector_test, reopen)
+{
+	std::string path = ::testing::TempDir() + "persistent_rvector_test";
+	unlink(path.c_str());
+	const size_t n = 1 << 18;
+	{
+		persistent_rvector<Record> v(path);
+		EXPECT_TRUE(v.empty());
+		for(size_t i = 0; i < n; ++i)
+			v.push_back(Record{(int64_t) i, i * 0.5});
+		v.sync();
+	}
+	{
+		persistent_rvector<Record> v(path);
+		EXPECT_EQ(v.size(), n);
+		EXPECT_GE(v.capacity(), n);
+		for(size_t i = 0; i < n; ++i)
+			EXPECT_EQ(v[i].id, (int64_t) i);
+		v.resize(n / 2);
+		v.emplace_back(Record{-1, -1});
+	}
+	{
+		persistent_rvector<Record> v(path);
+		EXPECT_EQ(v.size(), n / 2 + 1);
+		EXPECT_EQ(v.back().id, -1);
+		EXPECT_EQ(v[n / 2 - 1].value, (n / 2 - 1) * 0.5);
+	}
+	EXPECT_THROW(persistent_rvector<int> v(path), std::runtime_error);
+	unlink(path.c_str());
+}
+
+// Whether the process still maps path.
+static bool maps_file(const std::string& path)
+{
+	std::ifstream maps("/proc/self/maps");
+	for(std::string line; std::getline(maps, line);)
+		if(line.find(path) != std::string::npos)
+			return true;
+	return false;
+}
+
+TEST(persistent_rvector_test, odd_file_size)
+{
+	struct big { int64_t id; char pad[4992]; };
+	std::string path = ::testing::TempDir() + "persistent_rvector_odd";
+	unlink(path.c_str());
+	const size_t page = mm::default_policy::page_size();
+	{
+		persistent_rvector<big> v(path);
+		v.push_back(big{7, {}});
+	}
+	// Four elements and most of a page more than they need.
+	ASSERT_EQ(truncate(path.c_str(), page + 6 * page), 0);
+	{
+		persistent_rvector<big> v(path);
+		EXPECT_EQ(v.capacity(), 6 * page / sizeof(big));
+		for(int64_t i = 1; i < 20; ++i)
+			v.push_back(big{i + 7, {}});
+		persistent_rvector<big> w(std::move(v));
+		v = std::move(w);
+		EXPECT_EQ(w.capacity(), 0u);
+		EXPECT_EQ(v.size(), 20u);
+	}
+	EXPECT_FALSE(maps_file(path));
+	{
+		persistent_rvector<big> v(path);
+		ASSERT_EQ(v.size(), 20u);
+		for(int64_t i = 0; i < 20; ++i)
+			EXPECT_EQ(v[i].id, i + 7);
+	}
+	EXPECT_FALSE(maps_file(path));
+	unlink(path.c_str());
+}
+
+struct cow_policy : mm::basic_policy<cow_policy>
+{
+	static constexpr bool copy_on_write = true;
+};
+
+TEST(rvector_cow_test, shared_pages)
+{
+	using namespace mm::telemetry;
+	const int n = 1 << 22;
+	rvector<int, cow_policy> a;
+	for(int i = 0; i < n; ++i)
+		a.push_back(i);
+	reset<int>();
+
+	rvector<int, cow_policy> b(a);
+	auto stats = snapshot<int>();
+	EXPECT_EQ(stats.count[cow_clones], 1u);
+	EXPECT_EQ(stats.count[bytes_copied], 0u);
+	EXPECT_EQ(b.size(), a.size());
+	EXPECT_NE(b.data(), a.data());
+
+	b[7] = -7;
+	a[9] = -9;
+	EXPECT_EQ(a[7], 7);
+	EXPECT_EQ(b[9], 9);
+
+	// a wrote a page since it was cloned, so the next clone copies it once.
+	rvector<int, cow_policy> c;
+	c = a;
+	EXPECT_EQ(c[9], -9);
+	EXPECT_EQ(c[7], 7);
+	EXPECT_EQ(snapshot<int>().count[bytes_copied], n * sizeof(int));
+	c[9] = 9;
+	EXPECT_EQ(a[9], -9);
+
+	rvector<int, cow_policy> d(a);
+	EXPECT_EQ(snapshot<int>().count[bytes_copied], n * sizeof(int));
+	EXPECT_EQ(d[9], -9);
+
+	for(int i = 0; i < n; ++i)
+		b.push_back(-i);
+	EXPECT_EQ(b[7], -7);
+	EXPECT_EQ(b[n + 5], -5);
+	EXPECT_EQ(a[n - 1], n - 1);
+	EXPECT_EQ(d[n - 1], n - 1);
+}
+
+TEST(rvector_append_test, steal_pages)
+{
+	using namespace mm::telemetry;
+	const int page_ints = mm::default_policy::page_size() / sizeof(int);
+	rvector<int> a, b;
+	for(int i = 0; i < page_ints * 4; ++i)
+		a.push_back(i);
+	for(int i = 0; i < page_ints * 300 + 5; ++i)
+		b.push_back(page_ints * 4 + i);
+	reset<int>();
+	a.append(std::move(b));
+	EXPECT_EQ(snapshot<int>().count[bytes_copied], 0u);
+	EXPECT_TRUE(b.empty());
+	EXPECT_EQ(a.size(), size_t(page_ints * 304 + 5));
+
+	// a now spans two mappings, which mremap may refuse to grow.
+	const size_t capacity = a.capacity();
+	while(a.size() <= capacity)
+		a.push_back((int) a.size());
+	for(int i = 0; i < (int) a.size(); ++i)
+		EXPECT_EQ(a[i], i);
+
+	b.resize(1000, 1);
+	b.append(rvector<int>(page_ints * 8, 2));
+	EXPECT_EQ(b.size(), size_t(1000 + page_ints * 8));
+	EXPECT_EQ(b[999], 1);
+	EXPECT_EQ(b[1000], 2);
+	EXPECT_EQ(b.back(), 2);
+}
+
+TEST(rvector_append_test, concat)
+{
+	const int shard = mm::default_policy::page_size() / sizeof(int) * 64;
+	rvector<rvector<int>> shards(8);
+	for(int s = 0; s < 8; ++s)
+		for(int i = 0; i < shard; ++i)
+			shards[s].push_back(s * shard + i);
+	rvector<std::string> strings{"a"};
+	strings.concat(rvector<std::string>{"b", "c"}, rvector<std::string>(3, "d"));
+	EXPECT_EQ(strings, (rvector<std::string>{"a", "b", "c", "d", "d", "d"}));
+
+	rvector<int> all;
+	mm::telemetry::reset<int>();
+	all.concat(std::move(shards[0]), std::move(shards[1]), std::move(shards[2]), 
+			std::move(shards[3]), std::move(shards[4]), std::move(shards[5]), 
+			std::move(shards[6]), std::move(shards[7]));
+	EXPECT_EQ(mm::telemetry::snapshot<int>().count[mm::telemetry::bytes_copied], 0u);
+	EXPECT_EQ(all.size(), size_t(shard * 8));
+	for(int i = 0; i < shard * 8; ++i)
+		EXPECT_EQ(all[i], i);
+}
+
+TEST(rvector_append_test, concat_unaligned_shards)
+{
+	using namespace mm::telemetry;
+	const int page_ints = mm::default_policy::page_size() / sizeof(int);
+	const int sizes[] = {page_ints * 64, page_ints * 64 + 3, page_ints * 64, 
+						page_ints * 32 + 1};
+	rvector<int> shards[4];
+	int total = 0;
+	for(int s = 0; s < 4; ++s)
+		for(int i = 0; i < sizes[s]; ++i)
+			shards[s].push_back(total++);
+	rvector<int> all;
+	reset<int>();
+	all.concat(std::move(shards[0]), std::move(shards[1]), std::move(shards[2]), 
+			std::move(shards[3]));
+	// The first two shards land on page boundaries, the later ones do not.
+	EXPECT_EQ(snapshot<int>().count[page_moves], 2u);
+	ASSERT_EQ(all.size(), size_t(total));
+	for(int i = 0; i < total; ++i)
+		ASSERT_EQ(all[i], i);
+	for(int i = 0; i < page_ints; ++i)
+		all.push_back(total + i);
+	EXPECT_EQ(all.back(), total + page_ints - 1);
+}
+
+TEST(rvector_shift_test, page_insert_erase)
+{
+	using namespace mm::telemetry;
+	const int page_ints = mm::default_policy::page_size() / sizeof(int);
+	const int n = 1 << 20;
+	rvector<int> v;
+	for(int i = 0; i < n; ++i)
+		v.push_back(i);
+	reset<int>();
+
+	v.insert(v.begin() + 1000, page_ints * 3, -1);
+	EXPECT_EQ(snapshot<int>().count[page_moves], 1u);
+	EXPECT_EQ(v.size(), size_t(n + page_ints * 3));
+	for(int i = 0; i < 1000; ++i)
+		EXPECT_EQ(v[i], i);
+	for(int i = 1000; i < 1000 + page_ints * 3; ++i)
+		EXPECT_EQ(v[i], -1);
+	for(int i = 1000; i < n; ++i)
+		EXPECT_EQ(v[i + page_ints * 3], i);
+
+	v.erase(v.begin() + 1000, v.begin() + 1000 + page_ints * 3);
+	EXPECT_EQ(snapshot<int>().count[page_moves], 2u);
+	ASSERT_EQ(v.size(), size_t(n));
+	for(int i = 0; i < n; ++i)
+		EXPECT_EQ(v[i], i);
+
+	std::vector<int> chunk(page_ints, 7);
+	v.insert(v.begin() + page_ints, chunk.begin(), chunk.end());
+	v.erase(v.begin() + 5, v.begin() + 5 + page_ints);
+	v.erase(v.begin() + 3, v.begin() + 4);
+	EXPECT_EQ(v[2], 2);
+	EXPECT_EQ(v[3], 4);
+	EXPECT_EQ(v[page_ints - 2], 7);
+	EXPECT_EQ(v[page_ints + 4], page_ints + 5);
+	EXPECT_EQ(v.back(), n - 1);
+	EXPECT_EQ(v.size(), size_t(n - 1));
+}
+
+TEST(rvector_shift_test, insert_into_stolen_pages)
+{
+	using namespace mm::telemetry;
+	const int page_ints = mm::default_policy::page_size() / sizeof(int);
+	const int n = 1 << 20;
+	rvector<int> a, b;
+	for(int i = 0; i < n; ++i)
+		a.push_back(i);
+	a.resize(a.capacity());
+	for(int i = 0; i < n; ++i)
+		b.push_back(i);
+	a.append(std::move(b));
+	a.resize(a.capacity());
+	const int total = int(a.size());
+	for(int i = 0; i < total; ++i)
+		a[i] = i;
+	reset<int>();
+
+	// The block spans two mappings, so it is copied once, straight into
+	// place around the gap.
+	a.insert(a.begin() + 1000, page_ints * 3, -1);
+	EXPECT_EQ(snapshot<int>().count[fallback_copies], 1u);
+	EXPECT_EQ(snapshot<int>().count[page_moves], 0u);
+	ASSERT_EQ(a.size(), size_t(total + page_ints * 3));
+	for(int i = 0; i < 1000; ++i)
+		ASSERT_EQ(a[i], i);
+	for(int i = 1000; i < 1000 + page_ints * 3; ++i)
+		ASSERT_EQ(a[i], -1);
+	for(int i = 1000; i < total; ++i)
+		ASSERT_EQ(a[i + page_ints * 3], i);
+}
+
+struct few_maps_policy : mm::basic_policy<few_maps_policy>
+{
+	static constexpr mm::size_type shift_max_maps = 1;
+};
+
+TEST(rvector_shift_test, map_count_cap)
+{
+	using namespace mm::telemetry;
+	const int page_ints = mm::default_policy::page_size() / sizeof(int);
+	const int n = 1 << 20;
+	rvector<int, few_maps_policy> v;
+	for(int i = 0; i < n; ++i)
+		v.push_back(i);
+	reset<int>();
+	size_t maps = mm::count_maps();
+	const int rounds = 200;
+	for(int r = 0; r < rounds; ++r)
+	{
+		v.insert(v.begin() + 1000 + r, page_ints, -1);
+		v.erase(v.begin() + 1000 + r, v.begin() + 1000 + r + page_ints);
+	}
+	// Shifts stop remapping by the first recount of the mappings.
+	EXPECT_LE(snapshot<int>().count[page_moves], mm::map_count_period);
+	EXPECT_LE(mm::count_maps(), maps + 3 * mm::map_count_period);
+	ASSERT_EQ(v.size(), size_t(n));
+	for(int i = 0; i < n; ++i)
+		ASSERT_EQ(v[i], i);
+}
+
+TEST(rvector_insert_test, growth_single_pass)
+{
+	using namespace mm::telemetry;
+	rvector<std::string> strings = {"a", "b", "c"};
+	strings.shrink_to_fit();
+	strings.insert(strings.begin() + 1, "x");
+	strings.insert(strings.begin(), 3, "y");
+	EXPECT_EQ(strings, (rvector<std::string>{"y", "y", "y", "a", "x", "b", "c"}));
+
+	rvector<std::unique_ptr<int>> ptrs;
+	for(int i = 0; i < 100; ++i)
+		ptrs.emplace(ptrs.begin() + ptrs.size() / 2, std::make_unique<int>(i));
+	EXPECT_EQ(ptrs.size(), 100u);
+	EXPECT_EQ(*ptrs[0], 1);
+	EXPECT_EQ(*ptrs[49], 99);
+
+	rvector<int> v(1000, 1);
+	v.shrink_to_fit();
+	reset<int>();
+	v.insert(v.begin() + 10, 5, 2);
+	EXPECT_LE(snapshot<int>().count[bytes_copied], 1000 * sizeof(int));
+	EXPECT_EQ(v.size(), 1005u);
+	EXPECT_EQ(v[9], 1);
+	EXPECT_EQ(v[10], 2);
+	EXPECT_EQ(v[14], 2);
+	EXPECT_EQ(v[15], 1);
+}
+
+struct interleave_policy : mm::basic_policy<interleave_policy>
+{
+	static constexpr mm::numa numa_mode = mm::numa::interleave;
+};
+
+TEST(rvector_numa_test, interleave_growth)
+{
+	rvector<int, interleave_policy> v;
+	v.push_back(0);
+	EXPECT_EQ(v.page_nodes(), std::vector<int>{0});
+	for(int i = 1; i < 1 << 20; ++i)
+		v.push_back(i);
+	if(mm::placement(v.data()) == mm::numa::none)
+		GTEST_SKIP();
+	EXPECT_EQ(mm::placement(v.data() + v.capacity() - 1), mm::numa::interleave);
+	EXPECT_EQ(mm::placement(rvector<int>(1 << 20).data()), mm::numa::none);
+
+	std::vector<int> nodes = v.page_nodes();
+	EXPECT_EQ(nodes.size(), v.size() * sizeof(int) / interleave_policy::page_size());
+	for(int node : nodes)
+		EXPECT_TRUE(mm::numa_allowed() >> node & 1);
+	for(int i = 0; i < (int) v.size(); ++i)
+		EXPECT_EQ(v[i], i);
+}
+
+struct parallel_policy : mm::basic_policy<parallel_policy>
+{
+	static constexpr size_t parallel_bytes = 1 << 20;
+};
+
+struct throwing_copy
+{
+	static inline std::atomic<int> live{0};
+	static inline std::atomic<int> copies_left{0};
+
+	int value;
+
+	throwing_copy(int v = 0) : value(v) { ++live; }
+	throwing_copy(const throwing_copy& other) : value(other.value)
+	{
+		if(--copies_left < 0)
+			throw std::runtime_error("copy");
+		++live;
+	}
+	~throwing_copy() { --live; }
+};
+
+TEST(rvector_parallel_test, fill)
+{
+	mm::thread_executor ex(4);
+	const size_t n = 3 << 20;
+	rvector<int, parallel_policy> v(ex, n, 7);
+	EXPECT_EQ(v.size(), n);
+	EXPECT_EQ(std::count(v.begin(), v.end(), 7), (long) n);
+
+	v.resize(ex, 2 * n, 3);
+	EXPECT_EQ(v[n - 1], 7);
+	EXPECT_EQ(v[n], 3);
+	EXPECT_EQ(std::count(v.begin(), v.end(), 3), (long) n);
+
+	v.assign(ex, n + 1, 5);
+	EXPECT_EQ(v.size(), n + 1);
+	EXPECT_EQ(std::count(v.begin(), v.end(), 5), (long) n + 1);
+
+	rvector<std::string, parallel_policy> strings(ex, 100000, "parallel");
+	EXPECT_EQ(strings[99999], "parallel");
+}
+
+TEST(rvector_parallel_test, rollback)
+{
+	mm::thread_executor ex(4);
+	const size_t n = 2 << 20;
+	throwing_copy::copies_left = n * 3 / 4;
+	{
+		throwing_copy value(1);
+		EXPECT_THROW((rvector<throwing_copy, parallel_policy>(ex, n, value)),
+					std::runtime_error);
+		EXPECT_EQ(throwing_copy::live, 1);
+	}
+
+	throwing_copy::copies_left = n;
+	rvector<throwing_copy, parallel_policy> v(ex, n / 2, throwing_copy(2));
+	EXPECT_EQ(throwing_copy::live, (int) n / 2);
+	v.reserve(n);
+	throwing_copy::copies_left = n / 4;
+	EXPECT_THROW(v.resize(ex, n, throwing_copy(3)), std::runtime_error);
+	EXPECT_EQ(v.size(), n / 2);
+	EXPECT_EQ(throwing_copy::live, (int) n / 2);
+}
+
+struct counting_executor
+{
+	int calls = 0;
+
+	template<typename F>
+	void bulk(size_t n, F f)
+	{
+		++calls;
+		for(size_t i = n; i-- > 0;)
+			f(i);
+	}
+};
+
+struct pooled_policy : parallel_policy
+{
+	static counting_executor& executor() noexcept
+	{
+		static counting_executor ex;
+		return ex;
+	}
+};
+
+TEST(rvector_parallel_test, copy)
+{
+	const int n = 3 << 20;
+	rvector<int, pooled_policy> v;
+	for(int i = 0; i < n; ++i)
+		v.push_back(i);
+	int calls = pooled_policy::executor().calls;
+	rvector<int, pooled_policy> copy(v);
+	EXPECT_EQ(pooled_policy::executor().calls, calls + 1);
+	EXPECT_EQ(copy, v);
+
+	rvector<int, pooled_policy> assigned;
+	assigned = v;
+	EXPECT_EQ(assigned, v);
+	std::vector<int> source(v.begin(), v.end());
+	assigned.assign(source.begin(), source.begin() + n / 2);
+	EXPECT_EQ(pooled_policy::executor().calls, calls + 3);
+	EXPECT_EQ(assigned.size(), size_t(n / 2));
+	EXPECT_EQ(assigned.back(), n / 2 - 1);
+
+	mm::thread_executor ex(4);
+	rvector<int, pooled_policy> threaded(ex, v);
+	EXPECT_EQ(threaded, v);
+	rvector<std::string, parallel_policy> strings(100000, "copy");
+	rvector<std::string, parallel_policy> copies(ex, strings);
+	EXPECT_EQ(copies, strings);
+	copies.assign(ex, strings.begin(), strings.begin() + 10);
+	EXPECT_EQ(copies.size(), 10u);
+}
+
+TEST(rvector_parallel_test, copy_rollback)
+{
+	mm::thread_executor ex(4);
+	const size_t n = 2 << 20;
+	throwing_copy::copies_left = n;
+	rvector<throwing_copy, parallel_policy> v(ex, n, throwing_copy(1));
+	EXPECT_EQ(throwing_copy::live, (int) n);
+
+	throwing_copy::copies_left = n / 2;
+	EXPECT_THROW((rvector<throwing_copy, parallel_policy>(ex, v)), 
+				std::runtime_error);
+	EXPECT_EQ(throwing_copy::live, (int) n);
+
+	throwing_copy::copies_left = n;
+	rvector<throwing_copy, parallel_policy> w(4, throwing_copy(2));
+	w.reserve(n);
+	throwing_copy::copies_left = n / 2;
+	EXPECT_THROW(w.assign(ex, v.begin(), v.end()), std::runtime_error);
+	EXPECT_EQ(w.size(), 0u);
+	EXPECT_EQ(throwing_copy::live, (int) n);
+}
+
+TEST(rvector_parallel_test, page_aligned_chunks)
+{
+	using element = std::array<char, 12>;
+	rvector<element, parallel_policy> v(3 << 20);
+	element* data = v.data() + 5;
+	const size_t n = v.size() - 5;
+	std::vector<std::pair<size_t, size_t>> runs;
+	std::mutex m;
+	mm::thread_executor ex(4);
+	mm::parallel_init<element, parallel_policy>(ex, data, n, 
+		[&](size_t from, size_t count) {
+			std::lock_guard<std::mutex> lock(m);
+			runs.emplace_back(from, count);
+		});
+	std::sort(runs.begin(), runs.end());
+	ASSERT_GT(runs.size(), 2u);
+	size_t next = 0;
+	for(auto [from, count] : runs)
+	{
+		EXPECT_EQ(from, next);
+		if(from > 0)
+		{
+			EXPECT_LT((uintptr_t) (data + from) % mm::parallel_chunk, 
+					sizeof(element));
+		}
+		next = from + count;
+	}
+	EXPECT_EQ(next, n);
+}
+
+TEST(rvector_stream_test, move_and_fill)
+{
+	const size_t bytes = 1 << 16;
+	std::vector<char> expected(bytes * 2), buffer(bytes * 2);
+	for(size_t i = 0; i < buffer.size(); ++i)
+		buffer[i] = char(i * 7 + 1);
+	for(long shift : {-4097L, -33L, -1L, 1L, 5L, 64L, 4096L})
+		for(size_t from : {0ul, 3ul, 4100ul})
+		{
+			std::vector<char> work = buffer;
+			expected = buffer;
+			size_t len = bytes - from % 17;
+			char* base = work.data() + 5000;
+			memmove(expected.data() + 5000 + from + shift, 
+					expected.data() + 5000 + from, len);
+			mm::stream_move(base + from + shift, base + from, len);
+			EXPECT_EQ(work, expected) << shift << " " << from;
+#if defined(__x86_64__)
+			work = buffer;
+			base = work.data() + 5000;
+			mm::stream_move_sse2(base + from + shift, base + from, len);
+			EXPECT_EQ(work, expected) << shift << " " << from;
+#endif
+		}
+
+	std::array<int, 4> quad = {1, 2, 3, 4};
+	std::vector<std::array<int, 4>> quads(1001);
+	mm::stream_fill(quads.data() + 1, 1000, quad);
+	EXPECT_EQ(std::count(quads.begin() + 1, quads.end(), quad), 1000);
+	std::vector<short> shorts(10001, 0);
+	mm::stream_fill(shorts.data() + 1, 9999, short(-3));
+	EXPECT_EQ(shorts[0], 0);
+	EXPECT_EQ(std::count(shorts.begin() + 1, shorts.end() - 1, -3), 9999);
+	EXPECT_EQ(shorts.back(), 0);
+	std::vector<std::array<char, 3>> triples(100);
+	mm::stream_fill(triples.data(), 100, std::array<char, 3>{1, 2, 3});
+	EXPECT_EQ(triples[99][2], 3);
+}
+
+struct stream_policy : mm::basic_policy<stream_policy>
+{
+	static constexpr size_t stream_bytes = 1 << 16;
+};
+
+TEST(rvector_stream_test, policy)
+{
+	const int n = 1 << 20;
+	rvector<int, stream_policy> v(n, 9);
+	EXPECT_EQ(std::count(v.begin(), v.end(), 9), n);
+	for(int i = 0; i < n; ++i)
+		v[i] = i;
+	rvector<int, stream_policy> copy(v);
+	EXPECT_EQ(copy, v);
+	v.insert(v.begin() + 3, -1);
+	EXPECT_EQ(v[2], 2);
+	EXPECT_EQ(v[3], -1);
+	EXPECT_EQ(v[4], 3);
+	EXPECT_EQ(v.back(), n - 1);
+	v.resize(3 * n, 5);
+	EXPECT_EQ(v[n], n - 1);
+	EXPECT_EQ(v[n + 1], 5);
+	EXPECT_EQ(v.back(), 5);
+}
+
+TEST(rvector_zero_test, untouched_until_written)
+{
+	const size_t n = 1 << 24;
+	rvector<long> v(n);
+	EXPECT_LE(resident_pages(v.data(), n * sizeof(long)), 1u);
+	EXPECT_EQ(std::count(v.begin(), v.end(), 0), (long) n);
+
+	v.assign(n, 7);
+	v.resize(n / 2);
+	v.resize(2 * n);
+	EXPECT_EQ(v[n / 2 - 1], 7);
+	EXPECT_EQ(std::count(v.begin() + n / 2, v.end(), 0), (long) n * 3 / 2);
+
+	rvector<long, cache_policy> cached(1 << 20, 5);
+	cached = rvector<long, cache_policy>();
+	rvector<long, cache_policy> reused(1 << 20);
+	EXPECT_EQ(std::count(reused.begin(), reused.end(), 0), 1 << 20);
+}
+
+TEST(rvector_zero_test, uninitialized_growth)
+{
+	int fds[2];
+	ASSERT_EQ(pipe(fds), 0);
+	const char message[] = "uninitialized";
+	ASSERT_EQ(write(fds[1], message, sizeof(message)), (ssize_t) sizeof(message));
+
+	rvector<char> buffer = {'>'};
+	char* tail = buffer.append_uninitialized(sizeof(message));
+	EXPECT_EQ(tail, buffer.data() + 1);
+	ASSERT_EQ(read(fds[0], tail, sizeof(message)), (ssize_t) sizeof(message));
+	EXPECT_STREQ(buffer.data() + 1, message);
+	EXPECT_EQ(buffer.size(), sizeof(message) + 1);
+	close(fds[0]);
+	close(fds[1]);
+
+	rvector<int> v;
+	for(int i = 0; i < 1000; ++i)
+		*v.append_uninitialized(1) = i;
+	EXPECT_LE(v.capacity(), 4096u);
+	EXPECT_EQ(v[999], 999);
+	int* end = v.resize_uninitialized(10);
+	EXPECT_EQ(end, v.data() + 10);
+	EXPECT_EQ(v.size(), 10u);
+	EXPECT_EQ(v.back(), 9);
+}
+
+TEST(rvector_zero_test, regrowth_after_shrink)
+{
+	rvector<std::array<int, 3>> v(1 << 20, {7, 7, 7});
+	v.resize(100000);
+	v.shrink_to_fit();
+	v.resize(1 << 20);
+	for(size_t i = 100000; i < v.size(); ++i)
+		ASSERT_EQ(v[i][0], 0) << i;
+	EXPECT_EQ(v[99999][2], 7);
+}
+
+TEST(concurrent_rvector_test, producers)
+{
+	struct event
+	{
+		size_t id;
+		size_t check;
+		std::string name;
+	};
+	const size_t threads = 8, per_thread = 100000;
+	concurrent_rvector<event> events(threads * per_thread);
+	std::atomic<bool> done(false);
+	std::thread reader([&] {
+		size_t seen = 0;
+		while(!done)
+		{
+			size_t n = events.size();
+			EXPECT_GE(n, seen);
+			for(; seen < n; ++seen)
+				ASSERT_EQ(events[seen].check, ~events[seen].id);
+		}
+	});
+	std::vector<std::thread> producers;
+	for(size_t t = 0; t < threads; ++t)
+		producers.emplace_back([&, t] {
+			for(size_t i = 0; i < per_thread; ++i)
+			{
+				size_t id = t * per_thread + i;
+				events.push_back(event{id, ~id, "event"});
+			}
+		});
+	for(auto& producer : producers)
+		producer.join();
+	done = true;
+	reader.join();
+
+	ASSERT_EQ(events.size(), threads * per_thread);
+	std::vector<bool> found(threads * per_thread);
+	for(const event& e : events)
+		found[e.id] = true;
+	EXPECT_EQ(std::count(found.begin(), found.end(), true), 
+				(long) (threads * per_thread));
+	EXPECT_THROW(events.push_back(event{0, 0, ""}), std::length_error);
+	EXPECT_EQ(events.size(), threads * per_thread);
+}
+
+TEST(concurrent_rvector_test, throwing_constructor)
+{
+	concurrent_rvector<throwing_copy> v(100);
+	throwing_copy value(1);
+	throwing_copy::copies_left = 2;
+	v.push_back(value);
+	v.push_back(value);
+	EXPECT_THROW(v.push_back(value), std::runtime_error);
+	throwing_copy::copies_left = 1;
+	v.push_back(value);
+	EXPECT_EQ(v.size(), 2u);
+	EXPECT_EQ(v.at(1).value, 1);
+	EXPECT_THROW(v.at(3), std::out_of_range);
+}
+
+TEST(snapshot_rvector_test, held_across_growth)
+{
+	snapshot_rvector<std::string> v;
+	for(int i = 0; i < 10; ++i)
+		v.push_back(std::to_string(i));
+	{
+		auto snap = v.snapshot();
+		for(int i = 10; i < 100000; ++i)
+			v.push_back(v[i - 10]);
+		EXPECT_GT(v.retired_blocks(), 0u);
+		ASSERT_EQ(snap.size(), 10u);
+		for(int i = 0; i < 10; ++i)
+			EXPECT_EQ(snap[i], std::to_string(i));
+	}
+	v.reclaim();
+	EXPECT_EQ(v.retired_blocks(), 0u);
+	EXPECT_EQ(v.snapshot().at(99999), "9");
+}
+
+TEST(snapshot_rvector_test, concurrent_readers)
+{
+	const size_t n = 1 << 21;
+	snapshot_rvector<size_t> v;
+	std::atomic<bool> done(false);
+	std::vector<std::thread> readers;
+	for(int t = 0; t < 4; ++t)
+		readers.emplace_back([&] {
+			size_t last = 0;
+			while(!done)
+			{
+				auto snap = v.snapshot();
+				ASSERT_GE(snap.size(), last);
+				last = snap.size();
+				if(last == 0) continue;
+				ASSERT_EQ(snap[0], 0u);
+				ASSERT_EQ(snap[last / 2], last / 2);
+				ASSERT_EQ(snap[last - 1], last - 1);
+			}
+		});
+	for(size_t i = 0; i < n; ++i)
+		v.push_back(i);
+	done = true;
+	for(auto& reader : readers)
+		reader.join();
+	v.reclaim();
+	EXPECT_EQ(v.retired_blocks(), 0u);
+	auto snap = v.snapshot();
+	ASSERT_EQ(snap.size(), n);
+	for(size_t i = 0; i < n; ++i)
+		ASSERT_EQ(snap[i], i);
+}
+
+TEST(snapshot_rvector_test, double_growth_under_readers)
+{
+	auto value = [](size_t i) { return "element number " + std::to_string(i); };
+	snapshot_rvector<std::string> v;
+	v.push_back(value(0));
+	{
+		auto snap = v.snapshot();
+		v.reserve(v.capacity() * 2);
+		v.reserve(v.capacity() * 2);
+		// The middle block was never current for a reader.
+		EXPECT_EQ(v.retired_blocks(), 1u);
+		EXPECT_EQ(snap.at(0), value(0));
+	}
+	v.reclaim();
+	EXPECT_EQ(v.retired_blocks(), 0u);
+
+	const size_t n = 1 << 15;
+	std::atomic<bool> done(false);
+	std::vector<std::thread> readers;
+	for(int t = 0; t < 4; ++t)
+		readers.emplace_back([&] {
+			while(!done)
+			{
+				auto snap = v.snapshot();
+				size_t last = snap.size();
+				std::this_thread::yield();
+				ASSERT_EQ(snap[0], value(0));
+				ASSERT_EQ(snap[last / 2], value(last / 2));
+				ASSERT_EQ(snap[last - 1], value(last - 1));
+			}
+		});
+	for(size_t i = 1; i < n; ++i)
+	{
+		v.push_back(value(i));
+		if((i & (i - 1)) == 0)
+		{
+			v.reserve(v.capacity() + 1);
+			v.reserve(v.capacity() + 1);
+			std::this_thread::yield();
+		}
+	}
+	done = true;
+	for(auto& reader : readers)
+		reader.join();
+	v.reclaim();
+	EXPECT_EQ(v.retired_blocks(), 0u);
+	for(size_t i = 0; i < n; ++i)
+		ASSERT_EQ(v[i], value(i));
+}
+
+TEST(traced_rvector_test, record_and_read)
+{
+	using mm::trace::op;
+	std::string path = ::testing::TempDir() + "traced_rvector_test";
+	uint64_t a_id, b_id, c_id;
+	{
+		mm::trace::recorder recorder(path);
+		mm::trace::recorder::install(&recorder);
+		traced_rvector<int> a;
+		a.reserve(10);
+		for(int i = 0; i < 1000; ++i)
+			a.push_back(i);
+		a.pop_back();
+		a.pop_back();
+		a.insert(a.begin() + 5, 3, -1);
+		a.erase(a.begin() + 100, a.begin() + 200);
+		traced_rvector<int> b(a);
+		traced_rvector<int> c(std::move(b));
+		b.push_back(1);
+		a_id = a.trace_id();
+		b_id = b.trace_id();
+		c_id = c.trace_id();
+		EXPECT_EQ(c.size(), 901u);
+	}
+	std::vector<mm::trace::record> records;
+	mm::trace::reader reader(path);
+	for(mm::trace::record r; reader.next(r);)
+		records.push_back(r);
+	unlink(path.c_str());
+
+	auto expect = [&](size_t i, op code, uint64_t id, uint64_t a = 0, uint64_t b = 0) {
+		ASSERT_LT(i, records.size());
+		EXPECT_EQ(records[i].code, code) << i;
+		EXPECT_EQ(records[i].id, id) << i;
+		EXPECT_EQ(records[i].a, a) << i;
+		EXPECT_EQ(records[i].b, b) << i;
+	};
+	ASSERT_EQ(records.size(), 12u);
+	expect(0, op::construct, a_id, sizeof(int));
+	expect(1, op::reserve, a_id, 10);
+	expect(2, op::push_back, a_id, 1000);
+	expect(3, op::pop_back, a_id, 2);
+	expect(4, op::insert, a_id, 5, 3);
+	expect(5, op::erase, a_id, 100, 100);
+	expect(6, op::copy, c_id, a_id);
+	expect(7, op::construct, b_id, sizeof(int));
+	expect(8, op::push_back, b_id, 1);
+	expect(9, op::destroy, c_id);
+	expect(10, op::destroy, b_id);
+	expect(11, op::destroy, a_id);
+	EXPECT_EQ(mm::trace::recorder::current(), nullptr);
+}
+
+TEST(traced_rvector_test, replayed_sizes)
+{
+	using mm::trace::op;
+	std::string path = ::testing::TempDir() + "traced_rvector_sizes";
+	mm::trace::recorder recorder(path);
+	mm::trace::recorder::install(&recorder);
+	traced_rvector<int> a(100), b(10), c{1, 2}, d(5), e(7);
+	b = std::move(a);
+	a.push_back(1);
+	a.assign({1, 2, 3});
+	c.swap(b);
+	b.append(std::move(c));
+	b.shrink_to_fit();
+	*b.append_uninitialized(4) = 4;
+	b.resize_uninitialized(50);
+	a.concat(std::move(d), std::move(e));
+	swap(a, d);
+	recorder.flush();
+	mm::trace::recorder::install(nullptr);
+
+	std::map<uint64_t, uint64_t> sizes;
+	mm::trace::reader reader(path);
+	for(mm::trace::record r; reader.next(r);)
+	{
+		uint64_t& size = sizes[r.id];
+		switch(r.code)
+		{
+			case op::copy: size = sizes[r.a]; break;
+			case op::resize: case op::assign: size = r.a; break;
+			case op::push_back: size += r.a; break;
+			case op::pop_back: size -= r.a; break;
+			case op::insert: size += r.b; break;
+			case op::erase: size -= r.b; break;
+			case op::destroy: sizes.erase(r.id); break;
+			default: break;
+		}
+	}
+	unlink(path.c_str());
+	EXPECT_EQ(sizes.size(), 5u);
+	for(auto* v : {&a, &b, &c, &d, &e})
+		EXPECT_EQ(sizes[v->trace_id()], v->size()) << v->trace_id();
+	EXPECT_EQ(a.size(), 0u);
+	EXPECT_EQ(b.size(), 50u);
+	EXPECT_EQ(d.size(), 15u);
+}
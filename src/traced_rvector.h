@@ -0,0 +1,725 @@
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "rvector.h"
+
+namespace mm
+{
+	// Operation traces of rvectors, to replay production allocation patterns
+	// against other vectors and policies. A trace is the magic followed by
+	// records: an op byte, the vector id and the op's arguments, all LEB128
+	// varints. Consecutive push_backs and pop_backs of one vector are
+	// written as a single run.
+	namespace trace
+	{
+		constexpr char magic[8] = {'R', 'V', 'T', 'R', 'A', 'C', 'E', 1};
+
+		enum class op : unsigned char
+		{
+			construct, // a = element size
+			copy,      // a = source id
+			destroy,
+			reserve,   // a = capacity
+			resize,    // a = size
+			assign,    // a = size
+			push_back, // a = count
+			pop_back,  // a = count
+			insert,    // a = position, b = count
+			erase,     // a = position, b = count
+			shrink_to_fit,
+			ops
+		};
+
+		constexpr int arguments[size_t(op::ops)] = {1, 1, 0, 1, 1, 1, 1, 1, 2, 2, 0};
+
+		struct record
+		{
+			op code;
+			uint64_t id;
+			uint64_t a = 0;
+			uint64_t b = 0;
+		};
+
+		// Appends records to a trace file. Safe to use from several threads;
+		// the file is written in blocks and completed on flush or destruction.
+		class recorder
+		{
+		public:
+			explicit recorder(const std::string& path)
+			 : out(path, std::ios::binary | std::ios::trunc)
+			{
+				if(!out)
+					throw std::runtime_error("cannot open trace " + path);
+				out.write(magic, sizeof(magic));
+			}
+
+			recorder(const recorder&) = delete;
+			recorder& operator=(const recorder&) = delete;
+
+			~recorder()
+			{
+				if(current() == this)
+					install(nullptr);
+				flush();
+			}
+
+			// The recorder new traced_rvectors log to, or nullptr.
+			static recorder* current() noexcept
+			{
+				return installed.load(std::memory_order_acquire);
+			}
+
+			static void install(recorder* r) noexcept
+			{
+				installed.store(r, std::memory_order_release);
+			}
+
+			uint64_t construct(size_t element_size)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				uint64_t id = next_id++;
+				write(record{op::construct, id, element_size});
+				return id;
+			}
+
+			uint64_t copy(uint64_t source)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				uint64_t id = next_id++;
+				write(record{op::copy, id, source});
+				return id;
+			}
+
+			void log(op code, uint64_t id, uint64_t a = 0, uint64_t b = 0)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if(code == op::push_back or code == op::pop_back)
+				{
+					if(run and run->code == code and run->id == id)
+					{
+						run->a += a;
+						return;
+					}
+					flush_run();
+					run = record{code, id, a};
+					return;
+				}
+				write(record{code, id, a, b});
+			}
+
+			void flush()
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				flush_run();
+				out.write((const char*) buffer.data(), buffer.size());
+				out.flush();
+				buffer.clear();
+			}
+
+		private:
+			void flush_run()
+			{
+				if(!run) return;
+				encode(*run);
+				run.reset();
+			}
+
+			void write(const record& r)
+			{
+				flush_run();
+				encode(r);
+				if(buffer.size() >= block)
+				{
+					out.write((const char*) buffer.data(), buffer.size());
+					buffer.clear();
+				}
+			}
+
+			void encode(const record& r)
+			{
+				buffer.push_back((unsigned char) r.code);
+				varint(r.id);
+				if(arguments[size_t(r.code)] > 0) varint(r.a);
+				if(arguments[size_t(r.code)] > 1) varint(r.b);
+			}
+
+			void varint(uint64_t v)
+			{
+				for(; v >= 0x80; v >>= 7)
+					buffer.push_back((unsigned char) (v | 0x80));
+				buffer.push_back((unsigned char) v);
+			}
+
+			static constexpr size_t block = 64 << 10;
+			static inline std::atomic<recorder*> installed{nullptr};
+
+			std::mutex lock;
+			std::ofstream out;
+			std::vector<unsigned char> buffer;
+			std::optional<record> run;
+			uint64_t next_id = 1;
+		};
+
+		// Reads back the records of a trace file in order.
+		class reader
+		{
+		public:
+			explicit reader(const std::string& path)
+			 : in(path, std::ios::binary)
+			{
+				char header[sizeof(magic)];
+				if(!in.read(header, sizeof(header)) or
+				   memcmp(header, magic, sizeof(magic)) != 0)
+					throw std::runtime_error("not an rvector trace: " + path);
+			}
+
+			bool next(record& r)
+			{
+				int code = in.get();
+				if(code == EOF)
+					return false;
+				if(code >= int(op::ops))
+					throw std::runtime_error("corrupt trace: op " +
+											 std::to_string(code));
+				r = record{op(code), varint()};
+				if(arguments[code] > 0) r.a = varint();
+				if(arguments[code] > 1) r.b = varint();
+				return true;
+			}
+
+		private:
+			uint64_t varint()
+			{
+				uint64_t v = 0;
+				for(int shift = 0; shift < 64; shift += 7)
+				{
+					int byte = in.get();
+					if(byte == EOF)
+						throw std::runtime_error("truncated trace");
+					v |= uint64_t(byte & 0x7f) << shift;
+					if(!(byte & 0x80))
+						return v;
+				}
+				throw std::runtime_error("corrupt trace: varint too long");
+			}
+
+			std::ifstream in;
+		};
+	}
+}
+
+// rvector that logs its construction, sizing and modifiers to the
+// installed mm::trace::recorder, if any when it was constructed. Ids follow
+// the storage, so moves and swaps hand them over with it. The members do
+// not append or swap plain rvectors, whose operations go unrecorded.
+template<typename T, typename Policy = mm::default_policy>
+class traced_rvector : public rvector<T, Policy>
+{
+    using base = rvector<T, Policy>;
+public:
+    using typename base::size_type;
+    using typename base::iterator;
+    using typename base::const_iterator;
+
+    traced_rvector();
+    explicit traced_rvector(size_type count);
+    traced_rvector(size_type count, const T& value);
+    traced_rvector(std::initializer_list<T> ilist);
+    traced_rvector(const traced_rvector& other);
+    traced_rvector(traced_rvector&& other) noexcept;
+    ~traced_rvector();
+
+    traced_rvector& operator =(const traced_rvector& other);
+    traced_rvector& operator =(traced_rvector&& other) noexcept;
+    traced_rvector& operator =(std::initializer_list<T> ilist);
+
+    void assign(size_type count, const T& value);
+    template<typename InputIt,
+        typename = typename std::iterator_traits<InputIt>::value_type>
+    void assign(InputIt first, InputIt last);
+    void assign(std::initializer_list<T> ilist);
+    template<typename Executor, typename = mm::Executor<Executor>>
+    void assign(Executor& ex, size_type count, const T& value);
+    template<typename Executor, typename InputIt,
+        typename = mm::Executor<Executor>,
+        typename = typename std::iterator_traits<InputIt>::value_type>
+    void assign(Executor& ex, InputIt first, InputIt last);
+
+    void resize(size_type sz);
+    T* resize_uninitialized(size_type sz);
+    T* append_uninitialized(size_type n);
+    void resize(size_type sz, const T& c);
+    template<typename Executor, typename = mm::Executor<Executor>>
+    void resize(Executor& ex, size_type sz, const T& c = T());
+    void reserve(size_type n);
+    void reserve(size_type n, mm::prefault mode,
+                 std::chrono::nanoseconds budget = std::chrono::milliseconds(1));
+    void shrink_to_fit();
+
+    template <class... Args>
+    void emplace_back(Args&&... args);
+    template <class... Args>
+    void fast_emplace_back(Args&&... args);
+    void push_back(const T& x);
+    void fast_push_back(const T& x);
+    void push_back(T&& x);
+    void fast_push_back(T&& x);
+    void pop_back() noexcept;
+    void safe_pop_back() noexcept;
+
+    template <class... Args>
+    iterator emplace(const_iterator position, Args&&... args);
+    iterator insert(iterator position, const T& x);
+    iterator insert(iterator position, T&& x);
+    iterator insert(iterator position, size_type n, const T& x);
+    template <class InputIterator,
+        typename = typename std::iterator_traits<InputIterator>::value_type>
+    iterator insert(iterator position, InputIterator first, InputIterator last);
+    iterator insert(iterator position, std::initializer_list<T> ilist);
+    void append(traced_rvector&& other);
+    template <class... Rvectors>
+    void concat(Rvectors&&... others);
+
+    iterator erase(iterator position);
+    iterator erase(iterator first, iterator last);
+    void swap(traced_rvector& other);
+    void clear() noexcept;
+
+    uint64_t trace_id() const noexcept;
+private:
+    void log(mm::trace::op code, uint64_t a = 0, uint64_t b = 0);
+    void log_noexcept(mm::trace::op code, uint64_t a = 0, uint64_t b = 0) noexcept;
+    void open();
+    void renew() noexcept;
+
+    mm::trace::recorder* recorder_;
+    uint64_t id_;
+};
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::open()
+{
+    recorder_ = mm::trace::recorder::current();
+    id_ = recorder_ ? recorder_->construct(sizeof(T)) : 0;
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::log(mm::trace::op code, uint64_t a, uint64_t b)
+{
+    if(recorder_)
+        recorder_->log(code, id_, a, b);
+}
+
+// Members that cannot throw stop recording the vector when logging fails.
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::log_noexcept(mm::trace::op code, uint64_t a,
+                                             uint64_t b) noexcept
+{
+    try
+    {
+        log(code, a, b);
+    }
+    catch(...)
+    {
+        recorder_ = nullptr;
+    }
+}
+
+// Records the vector, left empty by a move, under a new id.
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::renew() noexcept
+{
+    if(!recorder_) return;
+    try
+    {
+        id_ = recorder_->construct(sizeof(T));
+    }
+    catch(...)
+    {
+        recorder_ = nullptr;
+    }
+}
+
+template<typename T, typename Policy>
+traced_rvector<T, Policy>::traced_rvector()
+{
+    open();
+}
+
+template<typename T, typename Policy>
+traced_rvector<T, Policy>::traced_rvector(size_type count)
+ : base(count)
+{
+    open();
+    log(mm::trace::op::resize, count);
+}
+
+template<typename T, typename Policy>
+traced_rvector<T, Policy>::traced_rvector(size_type count, const T& value)
+ : base(count, value)
+{
+    open();
+    log(mm::trace::op::resize, count);
+}
+
+template<typename T, typename Policy>
+traced_rvector<T, Policy>::traced_rvector(std::initializer_list<T> ilist)
+ : base(ilist)
+{
+    open();
+    log(mm::trace::op::resize, ilist.size());
+}
+
+template<typename T, typename Policy>
+traced_rvector<T, Policy>::traced_rvector(const traced_rvector& other)
+ : base(other),
+ recorder_(mm::trace::recorder::current()),
+ id_(0)
+{
+    if(recorder_ and recorder_ == other.recorder_)
+        id_ = recorder_->copy(other.id_);
+    else if(recorder_)
+    {
+        id_ = recorder_->construct(sizeof(T));
+        log(mm::trace::op::assign, this->size());
+    }
+}
+
+// The new vector takes over the storage and so the id; the source is
+// recorded as a new, empty vector.
+template<typename T, typename Policy>
+traced_rvector<T, Policy>::traced_rvector(traced_rvector&& other) noexcept
+ : base(std::move(other)),
+ recorder_(other.recorder_),
+ id_(other.id_)
+{
+    other.renew();
+}
+
+template<typename T, typename Policy>
+traced_rvector<T, Policy>::~traced_rvector()
+{
+    log_noexcept(mm::trace::op::destroy);
+}
+
+template<typename T, typename Policy>
+traced_rvector<T, Policy>&
+traced_rvector<T, Policy>::operator =(const traced_rvector& other)
+{
+    base::operator=(other);
+    log(mm::trace::op::assign, this->size());
+    return *this;
+}
+
+// The old storage is freed rather than swapped into other, which is left
+// without storage like a moved from vector and recorded under a new id.
+template<typename T, typename Policy>
+traced_rvector<T, Policy>&
+traced_rvector<T, Policy>::operator =(traced_rvector&& other) noexcept
+{
+    if(this == &other) return *this;
+    base::operator=(base(std::move(other)));
+    if(recorder_ and recorder_ == other.recorder_)
+    {
+        log_noexcept(mm::trace::op::destroy);
+        id_ = other.id_;
+    }
+    else
+    {
+        log_noexcept(mm::trace::op::assign, this->size());
+        other.log_noexcept(mm::trace::op::destroy);
+    }
+    other.renew();
+    return *this;
+}
+
+template<typename T, typename Policy>
+traced_rvector<T, Policy>&
+traced_rvector<T, Policy>::operator =(std::initializer_list<T> ilist)
+{
+    base::operator=(ilist);
+    log(mm::trace::op::assign, ilist.size());
+    return *this;
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::assign(size_type count, const T& value)
+{
+    base::assign(count, value);
+    log(mm::trace::op::assign, count);
+}
+
+template<typename T, typename Policy>
+template<typename InputIt, typename>
+void traced_rvector<T, Policy>::assign(InputIt first, InputIt last)
+{
+    base::assign(first, last);
+    log(mm::trace::op::assign, this->size());
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::assign(std::initializer_list<T> ilist)
+{
+    assign(ilist.begin(), ilist.end());
+}
+
+template<typename T, typename Policy>
+template<typename Executor, typename>
+void traced_rvector<T, Policy>::assign(Executor& ex, size_type count,
+                                       const T& value)
+{
+    base::assign(ex, count, value);
+    log(mm::trace::op::assign, count);
+}
+
+template<typename T, typename Policy>
+template<typename Executor, typename InputIt, typename, typename>
+void traced_rvector<T, Policy>::assign(Executor& ex, InputIt first, InputIt last)
+{
+    base::assign(ex, first, last);
+    log(mm::trace::op::assign, this->size());
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::resize(size_type sz)
+{
+    base::resize(sz);
+    log(mm::trace::op::resize, sz);
+}
+
+template<typename T, typename Policy>
+T* traced_rvector<T, Policy>::resize_uninitialized(size_type sz)
+{
+    T* tail = base::resize_uninitialized(sz);
+    log(mm::trace::op::resize, sz);
+    return tail;
+}
+
+// Recorded as push_backs, which grow the same way.
+template<typename T, typename Policy>
+T* traced_rvector<T, Policy>::append_uninitialized(size_type n)
+{
+    T* tail = base::append_uninitialized(n);
+    log(mm::trace::op::push_back, n);
+    return tail;
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::resize(size_type sz, const T& c)
+{
+    base::resize(sz, c);
+    log(mm::trace::op::resize, sz);
+}
+
+template<typename T, typename Policy>
+template<typename Executor, typename>
+void traced_rvector<T, Policy>::resize(Executor& ex, size_type sz, const T& c)
+{
+    base::resize(ex, sz, c);
+    log(mm::trace::op::resize, sz);
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::reserve(size_type n)
+{
+    base::reserve(n);
+    log(mm::trace::op::reserve, n);
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::reserve(size_type n, mm::prefault mode,
+                                        std::chrono::nanoseconds budget)
+{
+    base::reserve(n, mode, budget);
+    log(mm::trace::op::reserve, n);
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::shrink_to_fit()
+{
+    base::shrink_to_fit();
+    log(mm::trace::op::shrink_to_fit);
+}
+
+template<typename T, typename Policy>
+template <class... Args>
+void traced_rvector<T, Policy>::emplace_back(Args&&... args)
+{
+    base::emplace_back(std::forward<Args>(args)...);
+    log(mm::trace::op::push_back, 1);
+}
+
+template<typename T, typename Policy>
+template <class... Args>
+void traced_rvector<T, Policy>::fast_emplace_back(Args&&... args)
+{
+    base::fast_emplace_back(std::forward<Args>(args)...);
+    log(mm::trace::op::push_back, 1);
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::push_back(const T& x)
+{
+    emplace_back(x);
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::fast_push_back(const T& x)
+{
+    fast_emplace_back(x);
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::push_back(T&& x)
+{
+    emplace_back(std::move(x));
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::fast_push_back(T&& x)
+{
+    fast_emplace_back(std::move(x));
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::pop_back() noexcept
+{
+    base::pop_back();
+    log_noexcept(mm::trace::op::pop_back, 1);
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::safe_pop_back() noexcept
+{
+    if(this->empty()) return;
+    pop_back();
+}
+
+template<typename T, typename Policy>
+template <class... Args>
+typename traced_rvector<T, Policy>::iterator
+traced_rvector<T, Policy>::emplace(const_iterator position, Args&&... args)
+{
+    size_type i = position - this->begin();
+    iterator it = base::emplace(position, std::forward<Args>(args)...);
+    log(mm::trace::op::insert, i, 1);
+    return it;
+}
+
+template<typename T, typename Policy>
+typename traced_rvector<T, Policy>::iterator
+traced_rvector<T, Policy>::insert(iterator position, const T& x)
+{
+    return insert(position, size_type(1), x);
+}
+
+template<typename T, typename Policy>
+typename traced_rvector<T, Policy>::iterator
+traced_rvector<T, Policy>::insert(iterator position, T&& x)
+{
+    return emplace(position, std::move(x));
+}
+
+template<typename T, typename Policy>
+typename traced_rvector<T, Policy>::iterator
+traced_rvector<T, Policy>::insert(iterator position, size_type n, const T& x)
+{
+    size_type i = position - this->begin();
+    iterator it = base::insert(position, n, x);
+    log(mm::trace::op::insert, i, n);
+    return it;
+}
+
+template<typename T, typename Policy>
+template <class InputIterator, typename>
+typename traced_rvector<T, Policy>::iterator
+traced_rvector<T, Policy>::insert(iterator position, InputIterator first,
+                                  InputIterator last)
+{
+    size_type i = position - this->begin();
+    size_type length = this->size();
+    iterator it = base::insert(position, first, last);
+    log(mm::trace::op::insert, i, this->size() - length);
+    return it;
+}
+
+template<typename T, typename Policy>
+typename traced_rvector<T, Policy>::iterator
+traced_rvector<T, Policy>::insert(iterator position,
+                                  std::initializer_list<T> ilist)
+{
+    return insert(position, ilist.begin(), ilist.end());
+}
+
+// Recorded as an insert at the end and other emptied.
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::append(traced_rvector&& other)
+{
+    if(this == &other) return;
+    size_type length = this->size();
+    size_type n = other.size();
+    base::append(std::move(other));
+    log(mm::trace::op::insert, length, n);
+    other.log(mm::trace::op::resize, 0);
+}
+
+template<typename T, typename Policy>
+template <class... Rvectors>
+void traced_rvector<T, Policy>::concat(Rvectors&&... others)
+{
+    static_assert((std::is_same_v<Rvectors, traced_rvector> and ...),
+                  "concat takes traced_rvector rvalues");
+    reserve(this->size() + (others.size() + ... + 0));
+    (append(std::move(others)), ...);
+}
+
+template<typename T, typename Policy>
+typename traced_rvector<T, Policy>::iterator
+traced_rvector<T, Policy>::erase(iterator position)
+{
+    return erase(position, position + 1);
+}
+
+template<typename T, typename Policy>
+typename traced_rvector<T, Policy>::iterator
+traced_rvector<T, Policy>::erase(iterator first, iterator last)
+{
+    size_type i = first - this->begin();
+    iterator it = base::erase(first, last);
+    log(mm::trace::op::erase, i, last - first);
+    return it;
+}
+
+// Exchanges the storage along with the ids that record it.
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::swap(traced_rvector& other)
+{
+    base::swap(other);
+    std::swap(recorder_, other.recorder_);
+    std::swap(id_, other.id_);
+}
+
+template<typename T, typename Policy>
+void traced_rvector<T, Policy>::clear() noexcept
+{
+    base::clear();
+    log_noexcept(mm::trace::op::resize, 0);
+}
+
+template<typename T, typename Policy>
+uint64_t traced_rvector<T, Policy>::trace_id() const noexcept
+{
+    return id_;
+}
+
+template<typename T, typename Policy>
+void swap(traced_rvector<T, Policy>& x, traced_rvector<T, Policy>& y)
+{
+    x.swap(y);
+}